@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""Strong and weak scaling benchmark of HeatDiffusion on the local machine.
+
+Strong scaling solves one instance with 1..P ranks, weak scaling grows a generated plate with the number of ranks so
+every rank keeps the same number of cells. Every run writes a P5 image and a profile (--profile=PATH), the image is
+compared with a reference, by default the one of the run with the fewest ranks. Results go to CSV and JSON, the exit
+code is 1 when an image differs by more than the tolerance.
+
+Example, from hw2/cmake after a build into _gate_build:
+    ../benchmark/benchmark.py --build _gate_build --ranks 1,2,4 --strong ../instances/large_1.txt \\
+        --reference ../solutions/large_1.bmp --weak 512 --output results
+"""
+
+import argparse
+import csv
+import json
+import math
+import os
+import re
+import subprocess
+import sys
+import time
+
+
+def load_image(path):
+    """Width, height and pixels of a P2 or P5 graymap."""
+    with open(path, 'rb') as file:
+        data = file.read()
+
+    if data[:2] == b'P5':
+        # The pixels start one byte behind the maxval, splitting them off would drop leading whitespace-valued bytes.
+        header = re.match(rb'P5\s+(\d+)\s+(\d+)\s+(\d+)\s', data)
+        width, height = int(header.group(1)), int(header.group(2))
+        return width, height, list(data[header.end():header.end() + width * height])
+
+    tokens = data.split()
+    if tokens[0] != b'P2':
+        raise ValueError(path + ' is no P2 or P5 graymap')
+    width, height = int(tokens[1]), int(tokens[2])
+    return width, height, [int(token) for token in tokens[4:4 + width * height]]
+
+
+def max_pixel_diff(path, reference):
+    width, height, pixels = load_image(path)
+    ref_width, ref_height, ref_pixels = load_image(reference)
+    if (width, height) != (ref_width, ref_height):
+        return math.inf
+    return max((abs(a - b) for a, b in zip(pixels, ref_pixels)), default=0)
+
+
+def instance_size(path):
+    """Width, height and spot count of a text or binary instance."""
+    with open(path, 'rb') as file:
+        head = file.read(20)
+        if head[:4] == b'HDI1':
+            width = int.from_bytes(head[4:8], sys.byteorder, signed=True)
+            height = int.from_bytes(head[8:12], sys.byteorder, signed=True)
+            return width, height, int.from_bytes(head[12:20], sys.byteorder)
+
+    with open(path) as file:
+        width = int(file.readline())
+        height = int(file.readline())
+        return width, height, sum(1 for line in file if line.strip())
+
+
+def run(args, ranks, instance, name):
+    """Runs one solve and returns its measurements."""
+    image = os.path.join(args.output, name + '.pgm')
+    profile = os.path.join(args.output, name + '.json')
+    command = [args.mpirun, '-np', str(ranks)] + args.mpirun_args.split() + \
+              [args.binary, instance, image, '--format=p5', '--profile=' + profile] + args.solver_args.split()
+
+    began = time.time()
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    wall = time.time() - began
+    if result.returncode != 0:
+        raise RuntimeError('"' + ' '.join(command) + '" failed:\n' + result.stdout)
+
+    computational = re.search(r'computational time: ([0-9.eE+-]+)', result.stdout)
+    with open(profile) as file:
+        summary = json.load(file)
+
+    width, height, spots = instance_size(instance)
+    return {
+        'ranks': ranks,
+        'width': width,
+        'height': height,
+        'spots': spots,
+        'wall': wall,
+        'computational': float(computational.group(1)) if computational else None,
+        'solve': summary['summary']['solve']['max'],
+        'compute': summary['summary']['compute']['max'],
+        'halo': summary['summary']['halo']['max'],
+        'reduction': summary['summary']['reduction']['max'],
+        'sweeps': int(summary['summary']['sweeps']['max']),
+        'mlups': summary['mlups'],
+        'image': image,
+    }
+
+
+def strong_scaling(args):
+    results = []
+    for ranks in args.ranks:
+        results.append(run(args, ranks, args.strong, 'strong_{}'.format(ranks)))
+
+    reference = args.reference or results[0]['image']
+    for result in results:
+        result['mode'] = 'strong'
+        result['speedup'] = results[0]['solve'] * results[0]['ranks'] / result['solve']
+        result['efficiency'] = result['speedup'] / result['ranks']
+        result['maxDiff'] = max_pixel_diff(result['image'], reference)
+    return results
+
+
+def weak_scaling(args):
+    results = []
+    for ranks in args.ranks:
+        # The plate keeps its aspect ratio, the cells and the spots grow with the ranks.
+        side = int(round(args.weak * math.sqrt(ranks)))
+        spots = max(int(round(args.spot_density * side * side)), 1)
+        instance = os.path.join(args.output, 'weak_{}.bin'.format(ranks))
+        subprocess.run([args.generator, str(side), str(side), str(spots), instance, '--binary',
+                        '--seed={}'.format(args.seed)] + args.generator_args.split(), check=True)
+
+        # The plates differ, every run is checked against a run of its own with the fewest ranks.
+        result = run(args, ranks, instance, 'weak_{}'.format(ranks))
+        if ranks != args.ranks[0]:
+            check = run(args, args.ranks[0], instance, 'weak_{}_check'.format(ranks))
+            result['maxDiff'] = max_pixel_diff(result['image'], check['image'])
+        else:
+            result['maxDiff'] = 0
+        results.append(result)
+
+    # Larger plates need more sweeps, so the efficiency compares the time per sweep.
+    base = results[0]['solve'] / results[0]['sweeps']
+    for result in results:
+        result['mode'] = 'weak'
+        result['efficiency'] = base / (result['solve'] / result['sweeps'])
+        result['speedup'] = result['efficiency'] * result['ranks'] / results[0]['ranks']
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--build', default='.', help='build directory with HeatDiffusion and InstanceGenerator')
+    parser.add_argument('--ranks', default='1,2,4', help='comma separated rank counts')
+    parser.add_argument('--strong', help='instance of the strong scaling runs')
+    parser.add_argument('--reference', help='reference image of the strong scaling instance')
+    parser.add_argument('--weak', type=int, help='plate side of the single rank weak scaling run')
+    parser.add_argument('--spot-density', type=float, default=0.001, help='spots per cell of the weak scaling plates')
+    parser.add_argument('--seed', type=int, default=1, help='seed of the weak scaling plates')
+    parser.add_argument('--generator-args', default='', help='further InstanceGenerator options, e.g. "--clusters=4"')
+    parser.add_argument('--solver-args', default='', help='further HeatDiffusion options, e.g. "--scheme=mg"')
+    parser.add_argument('--mpirun', default='mpirun')
+    parser.add_argument('--mpirun-args', default='--oversubscribe', help='options of mpirun')
+    parser.add_argument('--tolerance', type=int, default=1, help='largest accepted pixel difference')
+    parser.add_argument('--output', default='benchmark', help='directory of the images, profiles and results')
+    args = parser.parse_args()
+
+    if not args.strong and not args.weak:
+        parser.error('nothing to do, give --strong INSTANCE and/or --weak SIDE')
+
+    args.ranks = [int(ranks) for ranks in args.ranks.split(',')]
+    args.binary = os.path.join(args.build, 'HeatDiffusion')
+    args.generator = os.path.join(args.build, 'InstanceGenerator')
+    os.makedirs(args.output, exist_ok=True)
+
+    results = []
+    if args.strong:
+        results += strong_scaling(args)
+    if args.weak:
+        results += weak_scaling(args)
+
+    columns = ['mode', 'ranks', 'width', 'height', 'spots', 'wall', 'computational', 'solve', 'compute', 'halo',
+               'reduction', 'sweeps', 'mlups', 'speedup', 'efficiency', 'maxDiff']
+    with open(os.path.join(args.output, 'results.csv'), 'w', newline='') as file:
+        writer = csv.DictWriter(file, fieldnames=columns, extrasaction='ignore')
+        writer.writeheader()
+        writer.writerows(results)
+    with open(os.path.join(args.output, 'results.json'), 'w') as file:
+        json.dump([{column: result[column] for column in columns} for result in results], file, indent=2)
+
+    failed = False
+    for result in results:
+        ok = result['maxDiff'] <= args.tolerance
+        failed = failed or not ok
+        print('{mode:6} {ranks:3} ranks {width}x{height}: {solve:.3f} s, {sweeps} sweeps, {mlups:.1f} MLUPS, '
+              'efficiency {efficiency:.2f}, max diff {maxDiff}'.format(**result) + ('' if ok else ' FAILED'))
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
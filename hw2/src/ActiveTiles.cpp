@@ -0,0 +1,91 @@
+#include <algorithm>
+#include "ActiveTiles.h"
+
+ActiveTiles::ActiveTiles(int side, float tolerance, const Decomposition &decomposition, int width, int height)
+        : side(side), tolerance(tolerance), width(width), height(height),
+          offsetX(decomposition.local.x0 % side), offsetY(decomposition.local.y0 % side) {
+    columns = (offsetX + width + side - 1) / side;
+    rows = (offsetY + height + side - 1) / side;
+
+    bool hasTop = decomposition.neighbours[0][1] != MPI_PROC_NULL;
+    bool hasBottom = decomposition.neighbours[2][1] != MPI_PROC_NULL;
+    bool hasLeft = decomposition.neighbours[1][0] != MPI_PROC_NULL;
+    bool hasRight = decomposition.neighbours[1][2] != MPI_PROC_NULL;
+
+    pinned.resize((size_t) rows * columns);
+    for (int ty = 0; ty < rows; ++ty) {
+        for (int tx = 0; tx < columns; ++tx) {
+            pinned[ty * columns + tx] = (ty == 0 && hasTop) || (ty == rows - 1 && hasBottom) ||
+                                        (tx == 0 && hasLeft) || (tx == columns - 1 && hasRight);
+        }
+    }
+
+    // Nothing is known at the start, every tile changes.
+    change.assign(pinned.size(), tolerance);
+    active.assign(pinned.size(), 1);
+    collect();
+}
+
+void ActiveTiles::collect() {
+    interior.clear();
+    border.clear();
+    for (int ty = 0; ty < rows; ++ty) {
+        std::vector<int> inner, outer;
+        for (int tile = ty * columns; tile < (ty + 1) * columns; ++tile) {
+            if (active[tile])
+                (pinned[tile] ? outer : inner).push_back(tile);
+        }
+
+        if (!inner.empty())
+            interior.push_back(std::move(inner));
+        if (!outer.empty())
+            border.push_back(std::move(outer));
+    }
+}
+
+void ActiveTiles::bounds(int tile, int &fromY, int &toY, int &fromX, int &toX) const {
+    int ty = tile / columns;
+    int tx = tile % columns;
+    fromY = std::max(ty * side - offsetY, 0);
+    toY = std::min((ty + 1) * side - offsetY, height);
+    fromX = std::max(tx * side - offsetX, 0);
+    toX = std::min((tx + 1) * side - offsetX, width);
+}
+
+void ActiveTiles::update(Grid &current, const Grid &next) {
+    if (!measuring()) {
+        sweep++;
+        return;
+    }
+    sweep++;
+
+    std::vector<uint8_t> wake(active.size());
+    for (int ty = 0; ty < rows; ++ty) {
+        for (int tx = 0; tx < columns; ++tx) {
+            float around = 0;
+            for (int y = std::max(ty - 1, 0); y <= std::min(ty + 1, rows - 1); ++y) {
+                for (int x = std::max(tx - 1, 0); x <= std::min(tx + 1, columns - 1); ++x)
+                    around = std::max(change[y * columns + x], around);
+            }
+            wake[ty * columns + tx] = pinned[ty * columns + tx] || around >= tolerance;
+        }
+    }
+
+    for (int tile = 0; tile < (int) active.size(); ++tile) {
+        if (!active[tile] || wake[tile])
+            continue;
+
+        int fromY, toY, fromX, toX;
+        bounds(tile, fromY, toY, fromX, toX);
+        for (int y = fromY; y < toY; ++y)
+            std::copy(next.row(y) + fromX, next.row(y) + toX, current.row(y) + fromX);
+    }
+
+    active = wake;
+    collect();
+}
+
+void ActiveTiles::activateAll() {
+    std::fill(active.begin(), active.end(), 1);
+    collect();
+}
@@ -0,0 +1,68 @@
+#ifndef HW2_ACTIVETILES_H
+#define HW2_ACTIVETILES_H
+
+#include <cstdint>
+#include <vector>
+#include "Grid.h"
+#include "Decomposition.h"
+
+// Incremental Jacobi sweeps: the owned block is cut into square tiles aligned to the global grid, and a tile is
+// skipped while its own last change and the last changes of its eight neighbour tiles stay under the tolerance. Its
+// inputs then barely move, so neither does its result. A changing neighbour reactivates it. Tiles on a side shared
+// with another rank read ghost cells whose change is unknown here, so they stay active.
+//
+// Calling the kernel once per tile and row costs more than the skipped cells save, so only every TILE_CHECK_SWEEPS-th
+// sweep measures the tiles and picks the tiles of the following sweeps, the sweeps in between call the kernel once per
+// run of consecutive active tiles.
+//
+// A skipped tile keeps its values in both buffers of the double buffer, a tile that goes quiet is copied once to the
+// buffer it is read from next.
+const int TILE_CHECK_SWEEPS = 8;
+
+class ActiveTiles {
+private:
+    int side;
+    float tolerance;
+    int width;
+    int height;
+    int offsetX;
+    int offsetY;
+    int columns;
+    int rows;
+
+    std::vector<uint8_t> pinned;
+    std::vector<uint8_t> active;
+    std::vector<float> change;
+    long sweep = 0;
+    std::vector<std::vector<int>> interior;
+    std::vector<std::vector<int>> border;
+
+    void collect();
+
+public:
+    ActiveTiles(int side, float tolerance, const Decomposition &decomposition, int width, int height);
+
+    // Active tiles that do not read ghost cells of a neighbour rank, and those that do, grouped by tile row so a
+    // band is swept row by row.
+    const std::vector<std::vector<int>> &interiorBands() const { return interior; }
+
+    const std::vector<std::vector<int>> &borderBands() const { return border; }
+
+    // Owned cells [fromY, toY) x [fromX, toX) of a tile.
+    void bounds(int tile, int &fromY, int &toY, int &fromX, int &toX) const;
+
+    // The current sweep measures the max change of every active tile.
+    bool measuring() const { return sweep % TILE_CHECK_SWEEPS == 0; }
+
+    // Max change of an active tile in a measuring sweep, written by the thread that swept it.
+    void record(int tile, float diff) { change[tile] = diff; }
+
+    // Called after every sweep from current into next and before the buffers swap. A measuring sweep picks the tiles
+    // of the following sweeps.
+    void update(Grid &current, const Grid &next);
+
+    // Sweeps every tile next time, e.g. to confirm a stop.
+    void activateAll();
+};
+
+#endif //HW2_ACTIVETILES_H
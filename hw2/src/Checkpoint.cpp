@@ -0,0 +1,130 @@
+#include <mpi.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "Checkpoint.h"
+#include "Options.h"
+#include "Instrumentation.h"
+
+const size_t MAGIC_BYTES = sizeof(CHECKPOINT_MAGIC) - 1;
+const size_t HEADER_BYTES = MAGIC_BYTES + 2 * sizeof(int32_t) + sizeof(int64_t) + sizeof(float);
+
+// File view of the owned block of the field behind the header, to be freed by the caller.
+static MPI_Datatype blockRegion(const Decomposition &decomposition) {
+    const Block &local = decomposition.local;
+    int sizes[2] = {decomposition.height, decomposition.width};
+    int subsizes[2] = {local.height, local.width};
+    int starts[2] = {local.y0, local.x0};
+
+    MPI_Datatype region;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_FLOAT, &region);
+    MPI_Type_commit(&region);
+    return region;
+}
+
+Checkpointer::Checkpointer(const Options &options, long firstIteration)
+        : path(options.checkpointPath), interval(options.checkpointInterval), lastWrite(MPI_Wtime()),
+          firstIteration(firstIteration) {
+}
+
+float Checkpointer::due() const {
+    return !path.empty() && MPI_Wtime() - lastWrite >= interval ? 1.0f : 0.0f;
+}
+
+void Checkpointer::write(const Grid &current, const Decomposition &decomposition, long iteration, float diff) {
+    PhaseTimer timer(Phase::Checkpoint);
+    const Block &local = decomposition.local;
+    std::string part = path + ".part";
+
+    std::vector<float> buffer((size_t) local.width * local.height);
+    for (int y = 0; y < local.height; ++y)
+        std::memcpy(&buffer[(size_t) y * local.width], current.row(y), local.width * sizeof(float));
+
+    MPI_File file;
+    if (MPI_File_open(decomposition.comm, part.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                      &file) != MPI_SUCCESS)
+        throw std::runtime_error("It is not possible to open checkpoint file!\n");
+
+    MPI_File_set_size(file, (MPI_Offset) (HEADER_BYTES + sizeof(float) * decomposition.width * decomposition.height));
+
+    if (decomposition.rank == 0) {
+        char header[HEADER_BYTES];
+        int32_t size[2] = {decomposition.width, decomposition.height};
+        int64_t total = firstIteration + iteration;
+        std::memcpy(header, CHECKPOINT_MAGIC, MAGIC_BYTES);
+        std::memcpy(header + MAGIC_BYTES, size, sizeof(size));
+        std::memcpy(header + MAGIC_BYTES + sizeof(size), &total, sizeof(total));
+        std::memcpy(header + MAGIC_BYTES + sizeof(size) + sizeof(total), &diff, sizeof(diff));
+        MPI_File_write_at(file, 0, header, (int) HEADER_BYTES, MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    MPI_Datatype region = blockRegion(decomposition);
+    MPI_File_set_view(file, (MPI_Offset) HEADER_BYTES, MPI_FLOAT, region, "native", MPI_INFO_NULL);
+    MPI_File_write_all(file, buffer.data(), (int) buffer.size(), MPI_FLOAT, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+    MPI_Type_free(&region);
+
+    int failed = decomposition.rank == 0 && std::rename(part.c_str(), path.c_str()) != 0;
+    MPI_Bcast(&failed, 1, MPI_INT, 0, decomposition.comm);
+    if (failed)
+        throw std::runtime_error("It is not possible to write checkpoint file!\n");
+
+    lastWrite = MPI_Wtime();
+}
+
+long readCheckpoint(const std::string &path, Grid &current, const Decomposition &decomposition, float &diff) {
+    const Block &local = decomposition.local;
+
+    MPI_File file;
+    if (MPI_File_open(decomposition.comm, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+        throw std::runtime_error("It is not possible to open restart file!\n");
+
+    MPI_Offset fileSize;
+    MPI_File_get_size(file, &fileSize);
+    MPI_Offset fieldBytes = (MPI_Offset) sizeof(float) * decomposition.width * decomposition.height;
+
+    // Rank 0 reads the header, -1 marks a file that fits neither format.
+    int64_t iteration = 0;
+    MPI_Offset offset = 0;
+    diff = 0;
+    if (decomposition.rank == 0) {
+        char header[HEADER_BYTES] = {};
+        if (fileSize >= (MPI_Offset) HEADER_BYTES)
+            MPI_File_read_at(file, 0, header, (int) HEADER_BYTES, MPI_BYTE, MPI_STATUS_IGNORE);
+
+        int32_t size[2];
+        std::memcpy(size, header + MAGIC_BYTES, sizeof(size));
+        if (std::memcmp(header, CHECKPOINT_MAGIC, MAGIC_BYTES) == 0) {
+            std::memcpy(&iteration, header + MAGIC_BYTES + sizeof(size), sizeof(iteration));
+            std::memcpy(&diff, header + MAGIC_BYTES + sizeof(size) + sizeof(iteration), sizeof(diff));
+            offset = (MPI_Offset) HEADER_BYTES;
+            if (size[0] != decomposition.width || size[1] != decomposition.height ||
+                fileSize != offset + fieldBytes)
+                offset = -1;
+        } else if (fileSize != fieldBytes) {
+            offset = -1;
+        }
+    }
+
+    MPI_Bcast(&offset, 1, MPI_OFFSET, 0, decomposition.comm);
+    MPI_Bcast(&iteration, 1, MPI_INT64_T, 0, decomposition.comm);
+    MPI_Bcast(&diff, 1, MPI_FLOAT, 0, decomposition.comm);
+    if (offset < 0) {
+        MPI_File_close(&file);
+        throw std::runtime_error("Restart file does not match the plate size!\n");
+    }
+
+    std::vector<float> buffer((size_t) local.width * local.height);
+    MPI_Datatype region = blockRegion(decomposition);
+    MPI_File_set_view(file, offset, MPI_FLOAT, region, "native", MPI_INFO_NULL);
+    MPI_File_read_all(file, buffer.data(), (int) buffer.size(), MPI_FLOAT, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+    MPI_Type_free(&region);
+
+    for (int y = 0; y < local.height; ++y)
+        std::memcpy(current.row(y), &buffer[(size_t) y * local.width], local.width * sizeof(float));
+
+    return (long) iteration;
+}
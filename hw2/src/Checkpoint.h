@@ -0,0 +1,42 @@
+#ifndef HW2_CHECKPOINT_H
+#define HW2_CHECKPOINT_H
+
+#include <string>
+#include "Grid.h"
+#include "Decomposition.h"
+
+struct Options;
+
+// First bytes of a checkpoint: the magic, int32 width and height, int64 iteration and float32 diff, followed by the
+// row-major float32 field of the whole plate, all in native byte order. Nothing in the file depends on the
+// decomposition, so a run may restart with another number of ranks.
+#define CHECKPOINT_MAGIC "HDC1"
+
+// Writes the state of the solve every checkpointInterval seconds of wall time to options.checkpointPath.
+class Checkpointer {
+private:
+    std::string path;
+    double interval;
+    double lastWrite;
+    long firstIteration;
+
+public:
+    // firstIteration is the iteration the solve restarted from, the checkpoints count on from it.
+    Checkpointer(const Options &options, long firstIteration);
+
+    // 1 once the interval elapsed on this rank, 0 otherwise or without a checkpoint path. The ranks agree on a
+    // checkpoint through a MAX reduction of the flags (see ConvergenceMonitor).
+    float due() const;
+
+    // Collective over decomposition.comm. The file is written next to the path and renamed when complete, so a run
+    // killed while writing keeps the previous checkpoint. Throws when the file cannot be written.
+    void write(const Grid &current, const Decomposition &decomposition, long iteration, float diff);
+};
+
+// Collective over decomposition.comm, every rank reads its block of a checkpoint or of a raw float32 output of a plate
+// of the same size into the owned cells of current. The spots are not part of the state and have to be imposed
+// afterwards, so the solution of a similar instance serves as a warm start as well. Returns the iteration of the
+// checkpoint, 0 for a raw field, and stores its diff. Throws when the file cannot be read or does not fit the plate.
+long readCheckpoint(const std::string &path, Grid &current, const Decomposition &decomposition, float &diff);
+
+#endif //HW2_CHECKPOINT_H
@@ -0,0 +1,71 @@
+#ifndef HW2_COMPACT_H
+#define HW2_COMPACT_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "Grid.h"
+
+// 16-bit fixed-point code of the temperatures, value = offset + code * scale. Zero has a code of its own, so the ghost
+// cells outside of the plate stay exactly zero.
+struct FixedPoint {
+    float offset = 0;
+    float scale = 1;
+    float inverse = 1;
+
+    FixedPoint() = default;
+
+    // Covers [low, high], which has to contain zero.
+    FixedPoint(float low, float high) {
+        scale = std::max(high - low, 1.0f) / 65534.0f;
+        offset = -scale * std::ceil(-low / scale);
+        inverse = 1.0f / scale;
+    }
+
+    float widen(uint16_t code) const {
+        return offset + (float) code * scale;
+    }
+
+    // Rounds half up and clamps in float, which keeps the loops over rows vectorized.
+    uint16_t narrow(float value) const {
+        float code = (value - offset) * inverse + 0.5f;
+        return (uint16_t) (int) std::min(std::max(code, 0.0f), 65535.0f);
+    }
+};
+
+// Block of the temperature field in the fixed-point code, with the shape and ghost ring of a Grid. Takes half the
+// memory and memory traffic of a Grid, the stencil works on rows widened to float.
+struct CompactGrid {
+    int width = 0;
+    int height = 0;
+    int halo = 0;
+    int stride = 0;
+    std::vector<uint16_t> data;
+
+    CompactGrid() = default;
+
+    // Encodes all cells of grid, ghost cells included.
+    CompactGrid(const Grid &grid, const FixedPoint &code)
+            : width(grid.width), height(grid.height), halo(grid.halo), stride(grid.stride), data(grid.size()) {
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = code.narrow(grid.cells[i]);
+    }
+
+    // Decodes all cells into grid of the same shape.
+    void widen(Grid &grid, const FixedPoint &code) const {
+        for (size_t i = 0; i < data.size(); ++i)
+            grid.cells[i] = code.widen(data[i]);
+    }
+
+    // Pointer to column 0 of row y, y and x may go down to -halo.
+    uint16_t *row(int y) {
+        return &data[(size_t) (y + halo) * stride + halo];
+    }
+
+    const uint16_t *row(int y) const {
+        return &data[(size_t) (y + halo) * stride + halo];
+    }
+};
+
+#endif //HW2_COMPACT_H
@@ -0,0 +1,229 @@
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "ConjugateGradient.h"
+#include "Options.h"
+#include "Convergence.h"
+#include "Checkpoint.h"
+#include "Snapshot.h"
+#include "Instrumentation.h"
+
+// Rows per band of the block preconditioner.
+const int BAND_ROWS = 64;
+
+// 1 / (count - 1) of the owned cells, zero for a spot and for a cell without neighbours, which never changes either.
+static Grid inverseDiagonalOf(const StencilData &stencil, int width, int height) {
+    Grid inverse(width, height, 0, 0.0f);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float diagonal = stencil.colWeight[x + stencil.halo] * stencil.rowWeight[y + stencil.halo] - 1.0f;
+            inverse.row(y)[x] = stencil.spotRow(y)[x] || diagonal == 0 ? 0.0f : 1.0f / diagonal;
+        }
+    }
+    return inverse;
+}
+
+static double localDot(const Grid &a, const Grid &b) {
+    double dot = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:dot)
+    for (int y = 0; y < a.height; ++y) {
+        const float *rowA = a.row(y);
+        const float *rowB = b.row(y);
+        for (int x = 0; x < a.width; ++x)
+            dot += (double) rowA[x] * rowB[x];
+    }
+
+    return dot;
+}
+
+static double globalSum(double value, MPI_Comm comm) {
+    PhaseTimer timer(Phase::Reduction);
+    double sum;
+    MPI_Allreduce(&value, &sum, 1, MPI_DOUBLE, MPI_SUM, comm);
+    return sum;
+}
+
+// One Gauss-Seidel update of row y of the band [fromY, toY) in direction step. Rows outside the band count as zero,
+// so the dependency chain stays inside the band. The rows above and below are summed up front, only the neighbours
+// in the row remain on the sequential chain. Spots have a zero inverse diagonal and stay zero.
+static void updateBandRow(const Grid &residual, const Grid &inverseDiagonal, Grid &preconditioned,
+                          int y, int fromY, int toY, int step) {
+    int width = residual.width;
+    static thread_local std::vector<float> zero;
+    static thread_local std::vector<float> partial;
+    zero.resize(width + 2, 0.0f);
+    partial.resize(width);
+
+    const float *above = y > fromY ? preconditioned.row(y - 1) : &zero[1];
+    const float *below = y + 1 < toY ? preconditioned.row(y + 1) : &zero[1];
+    const float *rhs = residual.row(y);
+    const float *inverse = inverseDiagonal.row(y);
+    float *row = preconditioned.row(y);
+
+    for (int x = 0; x < width; ++x)
+        partial[x] = rhs[x] + above[x - 1] + above[x] + above[x + 1] + below[x - 1] + below[x] + below[x + 1];
+
+    if (step > 0) {
+        for (int x = 0; x < width; ++x)
+            row[x] = (partial[x] + row[x + 1] + row[x - 1]) * inverse[x];
+    } else {
+        for (int x = width - 1; x >= 0; --x)
+            row[x] = (partial[x] + row[x - 1] + row[x + 1]) * inverse[x];
+    }
+}
+
+// Solves the band's part of A z = r approximately by a forward and a backward Gauss-Seidel sweep from z = 0, which is
+// a symmetric positive definite preconditioner as conjugate gradients require.
+static void symmetricGaussSeidel(const Grid &residual, const Grid &inverseDiagonal, Grid &preconditioned,
+                                 int fromY, int toY) {
+    for (int y = fromY; y < toY; ++y)
+        std::fill(preconditioned.row(y), preconditioned.row(y) + residual.width, 0.0f);
+
+    for (int y = fromY; y < toY; ++y)
+        updateBandRow(residual, inverseDiagonal, preconditioned, y, fromY, toY, 1);
+    for (int y = toY - 1; y >= fromY; --y)
+        updateBandRow(residual, inverseDiagonal, preconditioned, y, fromY, toY, -1);
+}
+
+// z = M^-1 r, zero on the spots.
+static void precondition(const Grid &residual, const Grid &inverseDiagonal, const Preconditioner &preconditioner,
+                         Grid &preconditioned) {
+    if (preconditioner == Preconditioner::Block) {
+        int bands = (residual.height + BAND_ROWS - 1) / BAND_ROWS;
+
+#pragma omp parallel for schedule(static)
+        for (int band = 0; band < bands; ++band)
+            symmetricGaussSeidel(residual, inverseDiagonal, preconditioned, band * BAND_ROWS,
+                                 std::min((band + 1) * BAND_ROWS, residual.height));
+        return;
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < residual.height; ++y) {
+        const float *in = residual.row(y);
+        const float *inverse = inverseDiagonal.row(y);
+        float *out = preconditioned.row(y);
+        for (int x = 0; x < residual.width; ++x)
+            out[x] = in[x] * inverse[x];
+    }
+}
+
+// q = A p on the owned cells, p is zero on the spots and its ghost cells must be up to date. Returns the local p.Ap.
+static double applyOperator(const Grid &direction, const StencilData &stencil, const Grid &inverseDiagonal,
+                            Grid &product) {
+    double energy = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:energy)
+    for (int y = 0; y < direction.height; ++y) {
+        const float *above = direction.row(y - 1);
+        const float *row = direction.row(y);
+        const float *below = direction.row(y + 1);
+        const float *inverse = inverseDiagonal.row(y);
+        float rowWeight = stencil.rowWeight[y + stencil.halo];
+        float *out = product.row(y);
+
+        for (int x = 0; x < direction.width; ++x) {
+            float sum = row[x - 1] + row[x + 1] +
+                        above[x] + above[x + 1] + above[x - 1] +
+                        below[x] + below[x + 1] + below[x - 1];
+            float diagonal = stencil.colWeight[x + stencil.halo] * rowWeight - 1.0f;
+            out[x] = inverse[x] == 0 ? 0.0f : diagonal * row[x] - sum;
+            energy += (double) row[x] * out[x];
+        }
+    }
+
+    return energy;
+}
+
+// x += alpha p and r -= alpha Ap, returns the largest change a Jacobi sweep would make with the new residual.
+static float step(Grid &current, Grid &residual, const Grid &direction, const Grid &product, const double &alpha,
+                  const StencilData &stencil) {
+    float diff = 0;
+
+#pragma omp parallel for schedule(static) reduction(max:diff)
+    for (int y = 0; y < current.height; ++y) {
+        float rowWeight = stencil.rowWeight[y + stencil.halo];
+        for (int x = 0; x < current.width; ++x) {
+            current.row(y)[x] += (float) (alpha * direction.row(y)[x]);
+            residual.row(y)[x] -= (float) (alpha * product.row(y)[x]);
+
+            float count = stencil.colWeight[x + stencil.halo] * rowWeight;
+            diff = std::max(std::abs(residual.row(y)[x]) / count, diff);
+        }
+    }
+
+    return diff;
+}
+
+float solveConjugateGradient(Grid &current, const StencilData &stencil, const Decomposition &decomposition,
+                             HaloExchange &halo, const Options &options, Checkpointer &checkpointer,
+                             SnapshotWriter &snapshots) {
+    int width = current.width;
+    int height = current.height;
+    Grid residual(width, height, 0, 0.0f);
+    // The ghost ring stays zero, the band sweeps read it on the sides of the block.
+    Grid preconditioned(width, height, 1, 0.0f);
+    Grid product(width, height, 0, 0.0f);
+    // Same shape as current, so the halo exchange of the temperatures serves it as well.
+    Grid direction(width, height, current.halo, 0.0f);
+    Grid inverseDiagonal = inverseDiagonalOf(stencil, width, height);
+    long iteration = 0;
+
+    while (true) {
+        halo.start(current);
+        halo.finish();
+
+        float myDiff = stencilResidual(current, stencil, residual);
+        float diff;
+        {
+            PhaseTimer timer(Phase::Reduction);
+            MPI_Allreduce(&myDiff, &diff, 1, MPI_FLOAT, MPI_MAX, decomposition.comm);
+        }
+        if (diff < CONVERGENCE_THRESHOLD)
+            return diff;
+
+        precondition(residual, inverseDiagonal, options.preconditioner, preconditioned);
+        double projection = globalSum(localDot(residual, preconditioned), decomposition.comm);
+        for (int y = 0; y < height; ++y)
+            std::copy(preconditioned.row(y), preconditioned.row(y) + width, direction.row(y));
+
+        // The residual of conjugate gradients is not monotone, so a stop is confirmed with the last iteration.
+        ConvergenceMonitor convergence(decomposition.comm, CONVERGENCE_THRESHOLD, options.checkInterval, 64, false);
+
+        bool converged;
+        do {
+            halo.start(direction);
+            halo.finish();
+
+            double energy = globalSum(applyOperator(direction, stencil, inverseDiagonal, product), decomposition.comm);
+            if (energy <= 0)
+                break;
+
+            double alpha = projection / energy;
+            float stepDiff = step(current, residual, direction, product, alpha, stencil);
+
+            precondition(residual, inverseDiagonal, options.preconditioner, preconditioned);
+            double nextProjection = globalSum(localDot(residual, preconditioned), decomposition.comm);
+            double beta = nextProjection / projection;
+            projection = nextProjection;
+
+#pragma omp parallel for schedule(static)
+            for (int y = 0; y < height; ++y) {
+                const float *in = preconditioned.row(y);
+                float *out = direction.row(y);
+                for (int x = 0; x < width; ++x)
+                    out[x] = (float) (in[x] + beta * out[x]);
+            }
+
+            iteration++;
+            recordSweep((long) width * height);
+            converged = convergence.update(iteration, stepDiff, checkpointer.due(), snapshots.due());
+            // The iterate alone restarts the solve, the search direction is rebuilt from its residual.
+            if (!converged && convergence.checkpointDue())
+                checkpointer.write(current, decomposition, iteration, convergence.diff());
+            if (!converged)
+                snapshots.offer(current, iteration, convergence.snapshotDue());
+        } while (!converged);
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef HW2_CONJUGATEGRADIENT_H
+#define HW2_CONJUGATEGRADIENT_H
+
+#include "Grid.h"
+#include "Decomposition.h"
+#include "Halo.h"
+#include "Solver.h"
+
+// Preconditioned conjugate gradients on the symmetric system of the steady state, A x = b with count - 1 on the
+// diagonal and -1 for every neighbour that is no spot (see Multigrid.h). A is applied matrix-free after a halo
+// exchange of the search direction, the dot products are global sums. The recurrence for the residual drifts in float
+// arithmetic, so a stop is confirmed with the true residual and the iteration restarts from it otherwise. Stops once
+// the largest change a Jacobi sweep would make drops below the threshold and returns that change.
+float solveConjugateGradient(Grid &current, const StencilData &stencil, const Decomposition &decomposition,
+                             HaloExchange &halo, const Options &options, Checkpointer &checkpointer,
+                             SnapshotWriter &snapshots);
+
+#endif //HW2_CONJUGATEGRADIENT_H
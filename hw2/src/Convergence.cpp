@@ -0,0 +1,78 @@
+#include <cmath>
+#include <algorithm>
+#include "Convergence.h"
+#include "Instrumentation.h"
+
+ConvergenceMonitor::ConvergenceMonitor(MPI_Comm comm, float threshold, int interval, int maxInterval, bool monotone)
+        : comm(comm), threshold(threshold), interval(std::max(interval, 1)), adaptive(interval <= 0),
+          monotone(monotone), maxInterval(std::max(maxInterval, 1)) {
+    // The first reduction is started right after the first sweep.
+    waitIteration = 1;
+}
+
+ConvergenceMonitor::~ConvergenceMonitor() {
+    if (request != MPI_REQUEST_NULL)
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+}
+
+int ConvergenceMonitor::nextInterval(long iteration, float diff) {
+    if (!adaptive)
+        return interval;
+
+    // Estimate the number of remaining sweeps from the geometric decay between the last two checks and check twice as
+    // often as needed to hit it, so the overshoot stays a fraction of the remaining work. While the diff stagnates
+    // there is no usable estimate and the interval just doubles.
+    int next = std::min(interval * 2, maxInterval);
+    if (lastDiff > 0 && diff > 0 && diff < lastDiff && diff >= threshold) {
+        double ratePerIteration = std::log(diff / lastDiff) / (double) (iteration - lastIteration);
+        double remaining = std::log(threshold / diff) / ratePerIteration;
+        next = (int) std::min<double>(remaining / 2, maxInterval);
+    }
+
+    lastDiff = diff;
+    lastIteration = iteration;
+    interval = std::max(next, 1);
+
+    return interval;
+}
+
+bool ConvergenceMonitor::update(long iteration, float diff, float due, float snapshotDue) {
+    checkpointRequested = false;
+    snapshotRequest = 0;
+    if (iteration < waitIteration)
+        return false;
+
+    PhaseTimer timer(Phase::Reduction);
+
+    if (request != MPI_REQUEST_NULL) {
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+        float globalDiff = global[0];
+        reportedDiff = globalDiff;
+        reportedIteration = pendingIteration;
+
+        if (globalDiff < threshold && monotone)
+            return true;
+
+        if (globalDiff < threshold) {
+            MPI_Allreduce(&diff, &reportedDiff, 1, MPI_FLOAT, MPI_MAX, comm);
+            reportedIteration = iteration;
+
+            if (reportedDiff < threshold)
+                return true;
+        }
+
+        checkpointRequested = global[1] > 0;
+        snapshotRequest = global[2];
+    }
+
+    local[0] = diff;
+    local[1] = due;
+    local[2] = snapshotDue;
+    pendingIteration = iteration;
+    MPI_Iallreduce(local, global, 3, MPI_FLOAT, MPI_MAX, comm, &request);
+
+    int step = reportedIteration > 0 ? nextInterval(reportedIteration, reportedDiff) : interval;
+    waitIteration = iteration + step;
+
+    return false;
+}
@@ -0,0 +1,65 @@
+#ifndef HW2_CONVERGENCE_H
+#define HW2_CONVERGENCE_H
+
+#include <mpi.h>
+
+// Detects convergence with a non-blocking MPI_MAX reduction of the local diffs.
+//
+// The reduction of the diff of iteration i is started at iteration i and completed at iteration i + interval, so the
+// collective overlaps with the sweeps in between. Every rank makes the decision at the same iteration. The sweeps
+// done while the reduction was in flight are harmless: the averaging operator has row sums <= 1, so the max diff of a
+// Jacobi or Gauss-Seidel sweep never grows and the field at the stop is at least as converged as the reported diff says.
+// Schemes without that property (over-relaxation) pass monotone = false, and a stop is then confirmed with a blocking
+// reduction of the diff of the last sweep.
+//
+// The same reduction carries flags for the wall-time driven checkpoints and snapshots, so the ranks agree on the
+// iteration of a checkpoint or snapshot without another collective.
+class ConvergenceMonitor {
+private:
+    MPI_Comm comm;
+    float threshold;
+    int interval;
+    bool adaptive;
+    bool monotone;
+    int maxInterval;
+
+    MPI_Request request = MPI_REQUEST_NULL;
+    // Diff, checkpoint and snapshot flag.
+    float local[3] = {0, 0, 0};
+    float global[3] = {0, 0, 0};
+    bool checkpointRequested = false;
+    float snapshotRequest = 0;
+    long pendingIteration = -1;
+    long waitIteration = 0;
+
+    float lastDiff = -1;
+    long lastIteration = 0;
+    float reportedDiff = 0;
+    long reportedIteration = 0;
+
+    int nextInterval(long iteration, float diff);
+
+public:
+    // interval <= 0 picks the interval adaptively from the observed convergence rate.
+    ConvergenceMonitor(MPI_Comm comm, float threshold, int interval, int maxInterval = 64, bool monotone = true);
+
+    ~ConvergenceMonitor();
+
+    // Called after every sweep with the local diff of that sweep, returns true once the global diff fell under the
+    // threshold. The result is the same on all ranks of the communicator. due is 1 when the rank wants a checkpoint,
+    // snapshotDue is positive when it wants a snapshot.
+    bool update(long iteration, float diff, float due = 0, float snapshotDue = 0);
+
+    // True when the reduction completed by the last update carried a checkpoint request of any rank.
+    bool checkpointDue() const { return checkpointRequested; }
+
+    // Largest snapshot flag of the ranks in the reduction completed by the last update, 0 without a request.
+    float snapshotDue() const { return snapshotRequest; }
+
+    // Global diff of the last completed reduction and the iteration it belongs to.
+    float diff() const { return reportedDiff; }
+
+    long diffIteration() const { return reportedIteration; }
+};
+
+#endif //HW2_CONVERGENCE_H
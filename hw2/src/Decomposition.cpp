@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "Decomposition.h"
+
+// Splits length into parts as equal as possible, the first parts take the remainder.
+static std::vector<int> evenStarts(int length, int parts) {
+    std::vector<int> starts(parts + 1);
+    for (int i = 0; i <= parts; ++i)
+        starts[i] = (int) ((long long) length * i / parts);
+    return starts;
+}
+
+std::vector<int> balancedStarts(const std::vector<long> &work, int parts, double firstShare) {
+    int length = (int) work.size();
+    std::vector<double> prefix(length + 1, 0.0);
+    for (int i = 0; i < length; ++i)
+        prefix[i + 1] = prefix[i] + work[i];
+
+    // Boundary p sits where the running work reaches the share of the parts before it.
+    double shares = firstShare + parts - 1;
+    std::vector<int> starts(parts + 1);
+    starts[0] = 0;
+    starts[parts] = length;
+    for (int part = 1; part < parts; ++part) {
+        double target = prefix[length] * (firstShare + part - 1) / shares;
+        int start = (int) (std::lower_bound(prefix.begin(), prefix.end(), target) - prefix.begin());
+        if (start > 0 && target - prefix[start - 1] < prefix[start] - target)
+            start--;
+        starts[part] = std::min(std::max(start, starts[part - 1] + 1), length - (parts - part));
+    }
+    return starts;
+}
+
+void chooseProcessGrid(int size, int width, int height, bool strips, int &processRows, int &processCols) {
+    if (processRows > 0 && processCols > 0) {
+        if (processRows * processCols != size)
+            throw std::runtime_error("Process grid " + std::to_string(processRows) + "x" +
+                                     std::to_string(processCols) + " does not match " + std::to_string(size) +
+                                     " processes!\n");
+        return;
+    }
+
+    if (strips) {
+        processRows = size;
+        processCols = 1;
+        return;
+    }
+
+    long long bestCut = -1;
+    for (int rows = 1; rows <= size; ++rows) {
+        if (size % rows != 0)
+            continue;
+
+        int cols = size / rows;
+        if (rows > height || cols > width)
+            continue;
+
+        long long cut = (long long) (rows - 1) * width + (long long) (cols - 1) * height;
+        if (bestCut < 0 || cut < bestCut) {
+            bestCut = cut;
+            processRows = rows;
+            processCols = cols;
+        }
+    }
+
+    if (bestCut < 0) {
+        processRows = size;
+        processCols = 1;
+    }
+}
+
+Decomposition createDecomposition(MPI_Comm parent, int width, int height, int processRows, int processCols,
+                                  const std::vector<int> &rowStarts, const std::vector<int> &colStarts) {
+    Decomposition decomposition;
+    decomposition.width = width;
+    decomposition.height = height;
+    decomposition.dims[0] = processRows;
+    decomposition.dims[1] = processCols;
+
+    if (processRows > height || processCols > width)
+        throw std::runtime_error("The plate is too small for the process grid!\n");
+
+    // Without reordering, rank 0 of the grid stays the rank that read the instance.
+    int periods[2] = {0, 0};
+    MPI_Cart_create(parent, 2, decomposition.dims, periods, 0, &decomposition.comm);
+    MPI_Comm_rank(decomposition.comm, &decomposition.rank);
+    MPI_Comm_size(decomposition.comm, &decomposition.size);
+    MPI_Cart_coords(decomposition.comm, decomposition.rank, 2, decomposition.coords);
+
+    decomposition.rowStarts = rowStarts.empty() ? evenStarts(height, processRows) : rowStarts;
+    decomposition.colStarts = colStarts.empty() ? evenStarts(width, processCols) : colStarts;
+    decomposition.local = decomposition.blockOf(decomposition.rank);
+
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            int neighbourCoords[2] = {decomposition.coords[0] + dy, decomposition.coords[1] + dx};
+            int &neighbour = decomposition.neighbours[dy + 1][dx + 1];
+
+            if (neighbourCoords[0] < 0 || neighbourCoords[0] >= processRows ||
+                neighbourCoords[1] < 0 || neighbourCoords[1] >= processCols || (dx == 0 && dy == 0))
+                neighbour = MPI_PROC_NULL;
+            else
+                MPI_Cart_rank(decomposition.comm, neighbourCoords, &neighbour);
+        }
+    }
+
+    return decomposition;
+}
+
+// Prefix sums of the halved parts of starts.
+static std::vector<int> halvedStarts(const std::vector<int> &starts) {
+    std::vector<int> halved(starts.size(), 0);
+    for (size_t i = 1; i < starts.size(); ++i)
+        halved[i] = halved[i - 1] + (starts[i] - starts[i - 1] + 1) / 2;
+    return halved;
+}
+
+Decomposition coarsenDecomposition(const Decomposition &fine) {
+    Decomposition coarse = fine;
+    MPI_Comm_dup(fine.comm, &coarse.comm);
+
+    coarse.rowStarts = halvedStarts(fine.rowStarts);
+    coarse.colStarts = halvedStarts(fine.colStarts);
+    coarse.height = coarse.rowStarts.back();
+    coarse.width = coarse.colStarts.back();
+    coarse.local = coarse.blockOf(coarse.rank);
+
+    return coarse;
+}
+
+void freeDecomposition(Decomposition &decomposition) {
+    if (decomposition.comm != MPI_COMM_NULL)
+        MPI_Comm_free(&decomposition.comm);
+}
+
+Block Decomposition::blockOf(int rank) const {
+    int rankCoords[2];
+    MPI_Cart_coords(comm, rank, 2, rankCoords);
+
+    return {colStarts[rankCoords[1]],
+            rowStarts[rankCoords[0]],
+            colStarts[rankCoords[1] + 1] - colStarts[rankCoords[1]],
+            rowStarts[rankCoords[0] + 1] - rowStarts[rankCoords[0]]};
+}
+
+void Decomposition::ranksCovering(int x, int y, int depth, std::vector<int> &ranks) const {
+    ranks.clear();
+
+    int ownerCoords[2];
+    MPI_Cart_coords(comm, ownerOf(x, y), 2, ownerCoords);
+
+    for (int row = std::max(ownerCoords[0] - 1, 0); row <= std::min(ownerCoords[0] + 1, dims[0] - 1); ++row) {
+        for (int col = std::max(ownerCoords[1] - 1, 0); col <= std::min(ownerCoords[1] + 1, dims[1] - 1); ++col) {
+            if (y < rowStarts[row] - depth || y >= rowStarts[row + 1] + depth ||
+                x < colStarts[col] - depth || x >= colStarts[col + 1] + depth)
+                continue;
+
+            int rankCoords[2] = {row, col};
+            int rank;
+            MPI_Cart_rank(comm, rankCoords, &rank);
+            ranks.push_back(rank);
+        }
+    }
+}
+
+int Decomposition::smallestBlockSide() const {
+    int side = height;
+    for (int i = 0; i < dims[0]; ++i)
+        side = std::min(side, rowStarts[i + 1] - rowStarts[i]);
+    for (int i = 0; i < dims[1]; ++i)
+        side = std::min(side, colStarts[i + 1] - colStarts[i]);
+    return side;
+}
+
+int Decomposition::ownerOf(int x, int y) const {
+    int ownerCoords[2] = {
+            (int) (std::upper_bound(rowStarts.begin(), rowStarts.end(), y) - rowStarts.begin()) - 1,
+            (int) (std::upper_bound(colStarts.begin(), colStarts.end(), x) - colStarts.begin()) - 1
+    };
+
+    int owner;
+    MPI_Cart_rank(comm, ownerCoords, &owner);
+    return owner;
+}
@@ -0,0 +1,69 @@
+#ifndef HW2_DECOMPOSITION_H
+#define HW2_DECOMPOSITION_H
+
+#include <mpi.h>
+#include <vector>
+
+// Rectangle of the plate in global coordinates.
+struct Block {
+    int x0;
+    int y0;
+    int width;
+    int height;
+};
+
+// Split of the plate into blocks over a 2D Cartesian process grid. Strips are the special case of a single process
+// column.
+struct Decomposition {
+    MPI_Comm comm = MPI_COMM_NULL;
+    int rank = 0;
+    int size = 1;
+
+    int width = 0;
+    int height = 0;
+
+    // Process rows and columns, and the position of this rank in the process grid.
+    int dims[2] = {1, 1};
+    int coords[2] = {0, 0};
+
+    // Global offsets of the process rows and columns, dims[i] + 1 entries each.
+    std::vector<int> rowStarts;
+    std::vector<int> colStarts;
+
+    // Block owned by this rank.
+    Block local = {};
+
+    // Rank of the neighbour at [dy + 1][dx + 1], MPI_PROC_NULL beyond the plate border.
+    int neighbours[3][3] = {};
+
+    Block blockOf(int rank) const;
+
+    int ownerOf(int x, int y) const;
+
+    // Ranks whose block extended by depth ghost layers contains [x, y], depth must not exceed smallestBlockSide().
+    void ranksCovering(int x, int y, int depth, std::vector<int> &ranks) const;
+
+    int smallestBlockSide() const;
+};
+
+// Picks the process grid with the shortest total cut between blocks, processRows = 0 and processCols = 0 choose
+// freely, strips fix a single process column.
+void chooseProcessGrid(int size, int width, int height, bool strips, int &processRows, int &processCols);
+
+// Splits work.size() rows or columns into parts with as equal work as possible, work[i] being the cost of row or
+// column i. The first part, which belongs to rank 0, aims at firstShare of the work of a regular part. Every part gets
+// at least one row or column. Returns the parts + 1 offsets.
+std::vector<int> balancedStarts(const std::vector<long> &work, int parts, double firstShare);
+
+// Collective over parent, creates the Cartesian communicator. rowStarts and colStarts give the offsets of the process
+// rows and columns and must be the same on all ranks, empty ones split evenly.
+Decomposition createDecomposition(MPI_Comm parent, int width, int height, int processRows, int processCols,
+                                  const std::vector<int> &rowStarts = {}, const std::vector<int> &colStarts = {});
+
+// Collective over fine.comm, halves every block on its own (rounding up) over a duplicate of the communicator, so
+// coarse cell i of a block covers its fine cells 2i and 2i + 1 and never reaches into a neighbour.
+Decomposition coarsenDecomposition(const Decomposition &fine);
+
+void freeDecomposition(Decomposition &decomposition);
+
+#endif //HW2_DECOMPOSITION_H
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "Ensemble.h"
+#include "Instance.h"
+
+// Fewest cells a rank of a group gets from the smallest instance when the group size is picked automatically.
+const long ENSEMBLE_CELLS_PER_RANK = 256 * 256;
+
+std::vector<EnsembleMember> readEnsemble(const std::string &path) {
+    std::ifstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("It is not possible to open ensemble file!\n");
+
+    std::vector<EnsembleMember> members;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        EnsembleMember member;
+        if (!(fields >> member.inputPath) || member.inputPath[0] == '#')
+            continue;
+
+        std::string rest;
+        if (!(fields >> member.outputPath) || fields >> rest)
+            throw std::runtime_error("Malformed ensemble file!\n");
+        members.push_back(member);
+    }
+
+    if (members.empty())
+        throw std::runtime_error("The ensemble file lists no instance!\n");
+
+    return members;
+}
+
+EnsembleScheduler::EnsembleScheduler(MPI_Comm comm, const std::vector<EnsembleMember> &members, int groupSize,
+                                     int haloDepth) {
+    int rank, ranks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &ranks);
+
+    int count = (int) members.size();
+    order.resize(count);
+    ranksTaken.resize(count);
+    if (rank == 0) {
+        std::vector<long> cells(count);
+        for (int i = 0; i < count; ++i) {
+            int width, height;
+            readInstanceSize(members[i].inputPath, width, height);
+            cells[i] = (long) width * height;
+            // Any process grid of up to that many ranks leaves every block haloDepth cells on each side.
+            ranksTaken[i] = std::max(std::min(width, height) / std::max(haloDepth, 1), 1);
+        }
+
+        for (int i = 0; i < count; ++i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return cells[a] > cells[b];
+        });
+
+        if (groupSize <= 0) {
+            long smallest = *std::min_element(cells.begin(), cells.end());
+            groupSize = (int) std::max(smallest / ENSEMBLE_CELLS_PER_RANK, 1L);
+        }
+    }
+
+    MPI_Bcast(order.data(), count, MPI_INT, 0, comm);
+    MPI_Bcast(ranksTaken.data(), count, MPI_INT, 0, comm);
+    MPI_Bcast(&groupSize, 1, MPI_INT, 0, comm);
+
+    size = std::min(groupSize, ranks);
+    groups = (ranks + size - 1) / size;
+    MPI_Comm_split(comm, rank / size, rank, &groupComm);
+    MPI_Comm_size(groupComm, &size);
+
+    int groupRank;
+    MPI_Comm_rank(groupComm, &groupRank);
+    leader = groupRank == 0;
+
+    // A single group counts on its own, and some MPI libraries have no RMA for a lone process.
+    if (groups > 1) {
+        MPI_Win_allocate(rank == 0 ? (MPI_Aint) sizeof(long) : 0, sizeof(long), MPI_INFO_NULL, comm, &counter, &window);
+        if (rank == 0)
+            *counter = 0;
+        MPI_Barrier(comm);
+        MPI_Win_lock_all(0, window);
+    }
+}
+
+EnsembleScheduler::~EnsembleScheduler() {
+    if (instanceComm != MPI_COMM_NULL)
+        MPI_Comm_free(&instanceComm);
+    if (window != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(window);
+        MPI_Win_free(&window);
+    }
+    MPI_Comm_free(&groupComm);
+}
+
+int EnsembleScheduler::next() {
+    long ticket = 0;
+    if (leader) {
+        if (window != MPI_WIN_NULL) {
+            const long one = 1;
+            MPI_Fetch_and_op(&one, &ticket, MPI_LONG, 0, 0, MPI_SUM, window);
+            MPI_Win_flush(0, window);
+        } else {
+            ticket = localCounter++;
+        }
+    }
+
+    MPI_Bcast(&ticket, 1, MPI_LONG, 0, groupComm);
+    if (instanceComm != MPI_COMM_NULL)
+        MPI_Comm_free(&instanceComm);
+    if (ticket >= (long) order.size())
+        return -1;
+
+    int index = order[ticket];
+    int groupRank;
+    MPI_Comm_rank(groupComm, &groupRank);
+    MPI_Comm_split(groupComm, groupRank < ranksTaken[index] ? 0 : MPI_UNDEFINED, groupRank, &instanceComm);
+    return index;
+}
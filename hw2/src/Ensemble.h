@@ -0,0 +1,64 @@
+#ifndef HW2_ENSEMBLE_H
+#define HW2_ENSEMBLE_H
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+// Instance of an ensemble and where its result goes.
+struct EnsembleMember {
+    std::string inputPath;
+    std::string outputPath;
+};
+
+// Reads an ensemble list, one "INPUT_PATH OUTPUT_PATH" line per instance. Empty lines and lines starting with # are
+// skipped. Throws when the file cannot be read, is malformed or lists no instance.
+std::vector<EnsembleMember> readEnsemble(const std::string &path);
+
+// Splits the ranks of a communicator into groups and hands the instances of an ensemble to the groups as they become
+// free.
+//
+// Without an explicit size a group gets as many ranks as the smallest instance fills with at least
+// ENSEMBLE_CELLS_PER_RANK cells each, so small instances run on single ranks side by side. An instance runs on as many
+// ranks of its group as its plate takes, a sub-communicator of the group, the other ranks of the group skip it. The
+// instances are handed out largest first, which keeps the groups busy until the end. The next instance is a shared
+// counter on rank 0 of the communicator that the leader of a group increments with MPI_Fetch_and_op, so a group never
+// waits for another one.
+class EnsembleScheduler {
+private:
+    MPI_Comm groupComm = MPI_COMM_NULL;
+    MPI_Comm instanceComm = MPI_COMM_NULL;
+    MPI_Win window = MPI_WIN_NULL;
+    long *counter = nullptr;
+    long localCounter = 0;
+    int size = 1;
+    int groups = 1;
+    bool leader = false;
+    // Indices of the members, largest instance first, and the most ranks each of them takes.
+    std::vector<int> order;
+    std::vector<int> ranksTaken;
+
+public:
+    // Collective over comm, rank 0 reads the sizes of the instances. groupSize 0 picks the size from the instances, a
+    // block of an instance keeps at least haloDepth cells on each side.
+    EnsembleScheduler(MPI_Comm comm, const std::vector<EnsembleMember> &members, int groupSize, int haloDepth);
+
+    EnsembleScheduler(const EnsembleScheduler &) = delete;
+
+    EnsembleScheduler &operator=(const EnsembleScheduler &) = delete;
+
+    // Collective over comm.
+    ~EnsembleScheduler();
+
+    // Collective over the group, the index of the member the group solves next or -1 once all are taken.
+    int next();
+
+    // Communicator of the ranks of the group that solve the member returned by next(), MPI_COMM_NULL on the others.
+    MPI_Comm instance() const { return instanceComm; }
+
+    int groupSize() const { return size; }
+
+    int groupCount() const { return groups; }
+};
+
+#endif //HW2_ENSEMBLE_H
@@ -0,0 +1,86 @@
+#ifndef HW2_GRID_H
+#define HW2_GRID_H
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+// Local block of the temperature field stored row-major with a ring of ghost cells around it.
+// Ghost cells that lie outside of the plate stay zero, so the stencil can read them unconditionally.
+//
+// The cells live in data unless they were attached to external memory, such as a shared memory window that the
+// neighbour ranks read in place. A copy always owns its cells.
+struct Grid {
+    int width = 0;
+    int height = 0;
+    int halo = 0;
+    int stride = 0;
+    std::vector<float> data;
+    float *cells = nullptr;
+
+    Grid() = default;
+
+    Grid(int width, int height, int halo, float value)
+            : width(width), height(height), halo(halo), stride(width + 2 * halo),
+              data((size_t) (height + 2 * halo) * (width + 2 * halo), 0.0f), cells(data.data()) {
+        for (int y = 0; y < height; ++y)
+            std::fill(row(y), row(y) + width, value);
+    }
+
+    Grid(const Grid &grid)
+            : width(grid.width), height(grid.height), halo(grid.halo), stride(grid.stride),
+              data(grid.cells, grid.cells + grid.size()), cells(data.data()) {
+    }
+
+    Grid(Grid &&grid) noexcept
+            : width(grid.width), height(grid.height), halo(grid.halo), stride(grid.stride),
+              data(std::move(grid.data)), cells(grid.cells) {
+        grid.cells = nullptr;
+    }
+
+    Grid &operator=(const Grid &grid) {
+        if (this != &grid)
+            *this = Grid(grid);
+        return *this;
+    }
+
+    Grid &operator=(Grid &&grid) noexcept {
+        width = grid.width;
+        height = grid.height;
+        halo = grid.halo;
+        stride = grid.stride;
+        data = std::move(grid.data);
+        cells = grid.cells;
+        grid.cells = nullptr;
+        return *this;
+    }
+
+    // Number of cells, ghost cells included.
+    size_t size() const {
+        return (size_t) (height + 2 * halo) * stride;
+    }
+
+    // Moves the cells to memory of size() floats that outlives the attachment.
+    void attach(float *memory) {
+        std::copy(cells, cells + size(), memory);
+        cells = memory;
+        data = std::vector<float>();
+    }
+
+    // Moves the cells back into owned storage.
+    void detach() {
+        data.assign(cells, cells + size());
+        cells = data.data();
+    }
+
+    // Pointer to column 0 of row y, y and x may go down to -halo.
+    float *row(int y) {
+        return &cells[(size_t) (y + halo) * stride + halo];
+    }
+
+    const float *row(int y) const {
+        return &cells[(size_t) (y + halo) * stride + halo];
+    }
+};
+
+#endif //HW2_GRID_H
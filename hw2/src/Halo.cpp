@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <stdexcept>
+#include "Halo.h"
+#include "Instrumentation.h"
+
+const int TAG_HALO = 10;
+
+Transport parseTransport(const std::string &name) {
+    if (name == "messages")
+        return Transport::Messages;
+    if (name == "shared")
+        return Transport::Shared;
+    if (name == "rma")
+        return Transport::Rma;
+
+    throw std::runtime_error("Unknown transport '" + name + "'!\n");
+}
+
+const char *transportName(Transport transport) {
+    switch (transport) {
+        case Transport::Messages:
+            return "messages";
+        case Transport::Shared:
+            return "shared";
+        case Transport::Rma:
+            return "rma";
+    }
+    return "unknown";
+}
+
+// Tag of a message travelling in direction (dy, dx).
+static int directionTag(int dy, int dx) {
+    return TAG_HALO + (dy + 1) * 3 + (dx + 1);
+}
+
+HaloExchange::HaloExchange(const Decomposition &decomposition, const Grid &grid, Transport transport)
+        : comm(decomposition.comm), halo(grid.halo), width(grid.width), height(grid.height), transport(transport) {
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            neighbours[dy + 1][dx + 1] = decomposition.neighbours[dy + 1][dx + 1];
+            targetTypes[dy + 1][dx + 1] = MPI_DATATYPE_NULL;
+
+            int rows = dy == 0 ? height : halo;
+            int cols = dx == 0 ? width : halo;
+            MPI_Type_vector(rows, cols, grid.stride, MPI_FLOAT, &types[dy + 1][dx + 1]);
+            MPI_Type_commit(&types[dy + 1][dx + 1]);
+            MPI_Type_vector(rows, cols, grid.stride, MPI_UINT16_T, &compactTypes[dy + 1][dx + 1]);
+            MPI_Type_commit(&compactTypes[dy + 1][dx + 1]);
+        }
+    }
+
+    requests.reserve(16);
+
+    // A single rank has nobody to exchange with, and some MPI libraries have no RMA for a lone process.
+    if (transport == Transport::Rma && decomposition.size == 1)
+        this->transport = Transport::Messages;
+    if (this->transport == Transport::Rma)
+        exposeToNeighbours(decomposition);
+    if (this->transport != Transport::Shared)
+        return;
+
+    // Finds the neighbours that live on the same node.
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, decomposition.rank, MPI_INFO_NULL, &node);
+    MPI_Group group, nodeGroup;
+    MPI_Comm_group(comm, &group);
+    MPI_Comm_group(node, &nodeGroup);
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            int neighbour = neighbours[dy + 1][dx + 1];
+            if (neighbour == MPI_PROC_NULL || (dy == 0 && dx == 0))
+                continue;
+
+            int nodeRank;
+            MPI_Group_translate_ranks(group, 1, &neighbour, nodeGroup, &nodeRank);
+            local[dy + 1][dx + 1] = nodeRank != MPI_UNDEFINED;
+            neighbourBlocks[dy + 1][dx + 1] = decomposition.blockOf(neighbour);
+        }
+    }
+    MPI_Group_free(&nodeGroup);
+    MPI_Group_free(&group);
+}
+
+// Group of the neighbours for the RMA epochs, and where the cells we send lie in the grid of the neighbour: the ghost
+// cells on its side facing us, with its own stride.
+void HaloExchange::exposeToNeighbours(const Decomposition &decomposition) {
+    std::vector<int> ranks;
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            int neighbour = neighbours[dy + 1][dx + 1];
+            if (neighbour == MPI_PROC_NULL || (dy == 0 && dx == 0))
+                continue;
+
+            Block block = decomposition.blockOf(neighbour);
+            neighbourBlocks[dy + 1][dx + 1] = block;
+            int neighbourStride = block.width + 2 * halo;
+            int rows = dy == 0 ? height : halo;
+            int cols = dx == 0 ? width : halo;
+            MPI_Type_vector(rows, cols, neighbourStride, MPI_FLOAT, &targetTypes[dy + 1][dx + 1]);
+            MPI_Type_commit(&targetTypes[dy + 1][dx + 1]);
+
+            int ghostY = dy > 0 ? -halo : (dy == 0 ? 0 : block.height);
+            int ghostX = dx > 0 ? -halo : (dx == 0 ? 0 : block.width);
+            targetOffsets[dy + 1][dx + 1] = (MPI_Aint) (ghostY + halo) * neighbourStride + ghostX + halo;
+
+            if (std::find(ranks.begin(), ranks.end(), neighbour) == ranks.end())
+                ranks.push_back(neighbour);
+        }
+    }
+
+    MPI_Group group;
+    MPI_Comm_group(comm, &group);
+    MPI_Group_incl(group, (int) ranks.size(), ranks.data(), &neighbourGroup);
+    MPI_Group_free(&group);
+}
+
+HaloExchange::~HaloExchange() {
+    while (!shared.empty())
+        release(*shared.back());
+
+    if (node != MPI_COMM_NULL)
+        MPI_Comm_free(&node);
+    if (neighbourGroup != MPI_GROUP_NULL && neighbourGroup != MPI_GROUP_EMPTY)
+        MPI_Group_free(&neighbourGroup);
+    for (auto &row: targetTypes)
+        for (auto &type: row)
+            if (type != MPI_DATATYPE_NULL)
+                MPI_Type_free(&type);
+
+    for (auto &row: types)
+        for (auto &type: row)
+            MPI_Type_free(&type);
+    for (auto &row: compactTypes)
+        for (auto &type: row)
+            MPI_Type_free(&type);
+}
+
+void HaloExchange::share(Grid &grid) {
+    if (transport == Transport::Messages)
+        return;
+
+    GridWindow window = {};
+    if (transport == Transport::Rma) {
+        MPI_Win_create(grid.cells, (MPI_Aint) (grid.size() * sizeof(float)), sizeof(float), MPI_INFO_NULL, comm,
+                       &window.window);
+        window.cells = grid.cells;
+        windows.push_back(window);
+        shared.push_back(&grid);
+        return;
+    }
+
+    float *memory;
+    MPI_Win_allocate_shared((MPI_Aint) (grid.size() * sizeof(float)), sizeof(float), MPI_INFO_NULL, node, &memory,
+                            &window.window);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, window.window);
+    grid.attach(memory);
+    window.cells = memory;
+
+    MPI_Group group, nodeGroup;
+    MPI_Comm_group(comm, &group);
+    MPI_Comm_group(node, &nodeGroup);
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            window.neighbourCells[dy + 1][dx + 1] = nullptr;
+            if (!local[dy + 1][dx + 1])
+                continue;
+
+            int nodeRank;
+            MPI_Group_translate_ranks(group, 1, &neighbours[dy + 1][dx + 1], nodeGroup, &nodeRank);
+
+            MPI_Aint size;
+            int unit;
+            float *cells;
+            MPI_Win_shared_query(window.window, nodeRank, &size, &unit, &cells);
+            window.neighbourCells[dy + 1][dx + 1] = cells;
+        }
+    }
+    MPI_Group_free(&nodeGroup);
+    MPI_Group_free(&group);
+
+    windows.push_back(window);
+    shared.push_back(&grid);
+}
+
+void HaloExchange::release(Grid &grid) {
+    auto position = std::find(shared.begin(), shared.end(), &grid);
+    if (position == shared.end())
+        return;
+
+    // Grids swapped with each other hold each other's window, the one of the cells goes.
+    GridWindow *window = windowOf(grid);
+    if (transport == Transport::Shared) {
+        grid.detach();
+        MPI_Win_unlock_all(window->window);
+    }
+    MPI_Win_free(&window->window);
+    windows.erase(windows.begin() + (window - windows.data()));
+    shared.erase(position);
+}
+
+HaloExchange::GridWindow *HaloExchange::windowOf(const Grid &grid) {
+    for (auto &window: windows) {
+        if (window.cells == grid.cells)
+            return &window;
+    }
+    return nullptr;
+}
+
+// Copies the boundary cells of the neighbours on the same node, the same cells the messages would carry.
+void HaloExchange::copyFromNeighbours(Grid &grid, const GridWindow &window) {
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            if (!local[dy + 1][dx + 1])
+                continue;
+
+            const Block &block = neighbourBlocks[dy + 1][dx + 1];
+            int neighbourStride = block.width + 2 * halo;
+            int rows = dy == 0 ? height : halo;
+            int cols = dx == 0 ? width : halo;
+
+            int recvY = dy < 0 ? -halo : (dy == 0 ? 0 : height);
+            int recvX = dx < 0 ? -halo : (dx == 0 ? 0 : width);
+            int sendY = dy >= 0 ? 0 : block.height - halo;
+            int sendX = dx >= 0 ? 0 : block.width - halo;
+
+            const float *source = window.neighbourCells[dy + 1][dx + 1] +
+                                  (size_t) (sendY + halo) * neighbourStride + sendX + halo;
+            for (int y = 0; y < rows; ++y)
+                std::copy(source + (size_t) y * neighbourStride, source + (size_t) y * neighbourStride + cols,
+                          grid.row(recvY + y) + recvX);
+        }
+    }
+}
+
+// Puts the boundary cells into the ghost cells of the neighbours facing us, the same cells the messages would carry.
+void HaloExchange::putToNeighbours(Grid &grid) {
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            int neighbour = neighbours[dy + 1][dx + 1];
+            if (neighbour == MPI_PROC_NULL || (dy == 0 && dx == 0))
+                continue;
+
+            int sendY = dy <= 0 ? 0 : height - halo;
+            int sendX = dx <= 0 ? 0 : width - halo;
+            MPI_Put(grid.row(sendY) + sendX, 1, types[dy + 1][dx + 1], neighbour, targetOffsets[dy + 1][dx + 1], 1,
+                    targetTypes[dy + 1][dx + 1], pendingWindow);
+        }
+    }
+}
+
+// Posts the receives into the ghost cells and the sends of the boundary cells, with skipLocal not to the neighbours
+// on the same node.
+template<typename Cells>
+void HaloExchange::postMessages(Cells &grid, MPI_Datatype (&cellTypes)[3][3], bool skipLocal) {
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            int neighbour = neighbours[dy + 1][dx + 1];
+            if (neighbour == MPI_PROC_NULL || (skipLocal && local[dy + 1][dx + 1]))
+                continue;
+
+            // Ghost cells in direction (dy, dx) and the boundary cells the neighbour there needs from us.
+            int recvY = dy < 0 ? -halo : (dy == 0 ? 0 : height);
+            int recvX = dx < 0 ? -halo : (dx == 0 ? 0 : width);
+            int sendY = dy <= 0 ? 0 : height - halo;
+            int sendX = dx <= 0 ? 0 : width - halo;
+
+            requests.emplace_back();
+            MPI_Irecv(grid.row(recvY) + recvX, 1, cellTypes[dy + 1][dx + 1], neighbour, directionTag(-dy, -dx), comm,
+                      &requests.back());
+
+            requests.emplace_back();
+            MPI_Isend(grid.row(sendY) + sendX, 1, cellTypes[dy + 1][dx + 1], neighbour, directionTag(dy, dx), comm,
+                      &requests.back());
+        }
+    }
+}
+
+void HaloExchange::start(Grid &grid) {
+    PhaseTimer timer(Phase::Halo);
+    requests.clear();
+
+    GridWindow *window = transport != Transport::Messages ? windowOf(grid) : nullptr;
+    if (window && transport == Transport::Rma) {
+        // Our ghost cells are free for the neighbours once we post, our boundary goes out once they have posted.
+        pendingWindow = window->window;
+        MPI_Win_post(neighbourGroup, 0, pendingWindow);
+        MPI_Win_start(neighbourGroup, 0, pendingWindow);
+        putToNeighbours(grid);
+        return;
+    }
+
+    if (window) {
+        // The boundaries of all ranks of the node are complete, the second sync orders our loads after their stores.
+        MPI_Win_sync(window->window);
+        MPI_Barrier(node);
+        MPI_Win_sync(window->window);
+        copyFromNeighbours(grid, *window);
+        sharedWindow = window->window;
+    }
+
+    postMessages(grid, types, window != nullptr);
+}
+
+void HaloExchange::start(CompactGrid &grid) {
+    PhaseTimer timer(Phase::Halo);
+    requests.clear();
+    postMessages(grid, compactTypes, false);
+}
+
+void HaloExchange::finish() {
+    PhaseTimer timer(Phase::Halo);
+    MPI_Waitall((int) requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+
+    // Our puts are done and so are the ones of the neighbours into our ghost cells.
+    if (pendingWindow != MPI_WIN_NULL) {
+        MPI_Win_complete(pendingWindow);
+        MPI_Win_wait(pendingWindow);
+        pendingWindow = MPI_WIN_NULL;
+    }
+
+    // No rank changes its boundary before all copies of it are done.
+    if (sharedWindow != MPI_WIN_NULL) {
+        MPI_Win_sync(sharedWindow);
+        MPI_Barrier(node);
+        MPI_Win_sync(sharedWindow);
+        sharedWindow = MPI_WIN_NULL;
+    }
+}
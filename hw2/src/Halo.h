@@ -0,0 +1,107 @@
+#ifndef HW2_HALO_H
+#define HW2_HALO_H
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+#include "Grid.h"
+#include "Compact.h"
+#include "Decomposition.h"
+
+// How the ghost cells travel between neighbours.
+//  - Messages sends them with non-blocking point-to-point messages.
+//  - Shared keeps the shared grids of the ranks of a node in MPI-3 shared memory windows, and a rank copies the
+//    boundary cells of a neighbour on the same node straight into its ghost cells. Neighbours on other nodes and grids
+//    that are not shared still use messages.
+//  - Rma exposes the shared grids in RMA windows and the neighbours put their boundary cells into our ghost cells
+//    with MPI_Put, synchronized by post-start-complete-wait epochs among the neighbours only.
+enum class Transport {
+    Messages,
+    Shared,
+    Rma
+};
+
+Transport parseTransport(const std::string &name);
+
+const char *transportName(Transport transport);
+
+// Non-blocking exchange of the ghost cells of a block with its eight neighbours. The sides are sent with strided
+// datatypes straight from the grid, the corners go to the diagonal neighbours that the 9-point stencil needs.
+// Missing neighbours are MPI_PROC_NULL, their ghost cells are left untouched.
+class HaloExchange {
+private:
+    // Window over the cells of a grid, and with shared memory the cells of the neighbours on the same node.
+    struct GridWindow {
+        MPI_Win window;
+        float *cells;
+        const float *neighbourCells[3][3];
+    };
+
+    MPI_Comm comm;
+    int neighbours[3][3];
+    int halo;
+    int width;
+    int height;
+    MPI_Datatype types[3][3];
+    MPI_Datatype compactTypes[3][3];
+    std::vector<MPI_Request> requests;
+
+    Transport transport;
+    MPI_Comm node = MPI_COMM_NULL;
+    // Neighbour on the same node, and the shape of its block.
+    bool local[3][3] = {};
+    Block neighbourBlocks[3][3] = {};
+    std::vector<GridWindow> windows;
+    std::vector<Grid *> shared;
+    MPI_Win sharedWindow = MPI_WIN_NULL;
+
+    // Neighbour ranks of the RMA epochs, and the ghost cells of the neighbours as seen from here.
+    MPI_Group neighbourGroup = MPI_GROUP_NULL;
+    MPI_Datatype targetTypes[3][3];
+    MPI_Aint targetOffsets[3][3] = {};
+    MPI_Win pendingWindow = MPI_WIN_NULL;
+
+    GridWindow *windowOf(const Grid &grid);
+
+    void copyFromNeighbours(Grid &grid, const GridWindow &window);
+
+    void exposeToNeighbours(const Decomposition &decomposition);
+
+    void putToNeighbours(Grid &grid);
+
+    template<typename Cells>
+    void postMessages(Cells &grid, MPI_Datatype (&cellTypes)[3][3], bool skipLocal);
+
+public:
+    // All grids passed to start() must have the shape of grid.
+    HaloExchange(const Decomposition &decomposition, const Grid &grid, Transport transport = Transport::Messages);
+
+    HaloExchange(const HaloExchange &) = delete;
+
+    HaloExchange &operator=(const HaloExchange &) = delete;
+
+    // Collective over the node like release(), moves the cells of the grids still shared back into owned storage.
+    ~HaloExchange();
+
+    // Collective over the ranks of the node (shared memory) or of the communicator (RMA), all ranks share their grids
+    // in the same order. Moves the cells of grid into a shared window or exposes them in an RMA window, with the
+    // message transport it does nothing. The grid must stay where it is until it is released, grids swapped with
+    // each other keep working as long as all ranks swap them alike.
+    void share(Grid &grid);
+
+    // Collective like share(), frees the window of a shared grid and moves its cells back into owned storage.
+    void release(Grid &grid);
+
+    // Posts the receives into the ghost cells and the sends of the boundary cells. The ghost cells from neighbours on
+    // the same node are copied right away once every rank of the node has finished its boundary, with RMA the boundary
+    // cells are put into the neighbours once they have posted their windows.
+    void start(Grid &grid);
+
+    // Same for a compact grid of the same shape, always with messages.
+    void start(CompactGrid &grid);
+
+    // Waits until the ghost cells are filled and the boundary cells may be overwritten.
+    void finish();
+};
+
+#endif //HW2_HALO_H
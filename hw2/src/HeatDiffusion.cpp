@@ -1,13 +1,27 @@
 #include <mpi.h>
 #include <chrono>
-#include <fstream>
 #include <vector>
-#include <sstream>
 #include <string>
 #include <algorithm>
 #include <tuple>
 #include <iostream>
 #include <cmath>
+#include <cstdint>
+#include "Grid.h"
+#include "Stencil.h"
+#include "Options.h"
+#include "Decomposition.h"
+#include "Solver.h"
+#include "Output.h"
+#include "Instance.h"
+#include "Checkpoint.h"
+#include "Instrumentation.h"
+#include "Ensemble.h"
+#include "WarmStart.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace std::chrono;
@@ -17,75 +31,45 @@ using namespace std::chrono;
 struct Problem {
     int width;
     int height;
-    int rootSize;
-    int slaveSize;
 };
 
-// Spot with permanent temperature on coordinates [x,y].
-struct Spot {
-    int mX;
-    int mY;
-    float mTemperature;
-
-    bool operator==(const Spot &b) const {
-        return (mX == b.mX) && (mY == b.mY);
-    }
-};
-
-bool compareByY(const Spot &a, const Spot &b) {
-    return a.mY < b.mY;
-}
-
-tuple<int, int, vector<Spot>> readInstance(string instanceFileName) {
-    int width, height;
-    vector<Spot> spots;
-    string line;
-
-    ifstream file(instanceFileName);
-    if (file.is_open()) {
-        int lineId = 0;
-        while (std::getline(file, line)) {
-            stringstream ss(line);
-            if (lineId == 0) {
-                ss >> width;
-            } else if (lineId == 1) {
-                ss >> height;
-            } else {
-                int i, j, temperature;
-                ss >> i >> j >> temperature;
-                spots.push_back({i, j, (float) temperature});
-            }
-            lineId++;
-        }
-        file.close();
-    } else {
-        throw runtime_error("It is not possible to open instance file!\n");
-    }
-    return make_tuple(width, height, spots);
-}
-
-void writeOutput(
-        const int myRank,
-        const int width,
-        const int height,
-        const string outputFileName,
-        const vector<float> &temperatures) {
-    // Draw the output image in Netpbm format.
-    ofstream file(outputFileName);
-    if (file.is_open()) {
-        if (myRank == 0) {
-            file << "P2\n" << width << "\n" << height << "\n" << 255 << "\n";
-            for (auto temperature: temperatures) {
-                file << (int) max(min(temperature, 255.0f), 0.0f) << " ";
-            }
-        }
-    }
-}
-
 void printHelpPage(char *program) {
     cout << "Simulates a simple heat diffusion." << endl;
     cout << endl << "Usage:" << endl;
-    cout << "\t" << program << " INPUT_PATH OUTPUT_PATH" << endl << endl;
+    cout << "\t" << program << " INPUT_PATH OUTPUT_PATH [OPTIONS]" << endl;
+    cout << "\t" << program << " --ensemble=LIST [OPTIONS]" << endl << endl;
+    cout << "Options:" << endl;
+    cout << "\t--kernel=auto|scalar|avx2|avx512\tstencil instruction set, scalar is the reference" << endl;
+    cout << "\t--check-every=N|auto\t\tglobal convergence check interval in iterations (default auto)" << endl;
+    cout << "\t--decomposition=blocks|strips\tsplit the plate into 2D blocks or horizontal strips" << endl;
+    cout << "\t--process-grid=RxC\t\texplicit grid of R process rows and C process columns" << endl;
+    cout << "\t--root-share=F\t\t\twork of the block of rank 0 relative to the others (default 1)" << endl;
+    cout << "\t--threads=N\t\t\tOpenMP threads per rank (default OMP_NUM_THREADS)" << endl;
+    cout << "\t--halo-depth=K\t\t\texchange K ghost layers once per K sweeps (default 1)" << endl;
+    cout << "\t--transport=messages|shared|rma\tghost cells as messages, copied from shared memory on a node or put"
+         << " with one-sided RMA (default messages)" << endl;
+    cout << "\t--scheme=jacobi|gs|sor|mg|cg\tJacobi, four-colour Gauss-Seidel, SOR, multigrid or conjugate gradients"
+         << " (default jacobi)" << endl;
+    cout << "\t--storage=float|compact\t\tJacobi starts on 16-bit fixed point and finishes in float (default float)"
+         << endl;
+    cout << "\t--active-tiles[=SIDE|off]\tJacobi skips quiet SIDE x SIDE tiles (default off, SIDE 64)" << endl;
+    cout << "\t--omega=W|auto\t\t\tSOR relaxation factor in (0, 2), auto estimates it (default auto)" << endl;
+    cout << "\t--preconditioner=jacobi|block\tconjugate gradient preconditioner (default block)" << endl;
+    cout << "\t--format=p2|p5|raw\t\toutput as ASCII or binary graymap or raw float32 (default p2)" << endl;
+    cout << "\t--checkpoint=PATH\t\twrite the state of the solve to PATH periodically" << endl;
+    cout << "\t--checkpoint-every=SECONDS\twall time between checkpoints (default 600)" << endl;
+    cout << "\t--snapshot=PATH\t\t\tstream frames of the field to PATH while solving" << endl;
+    cout << "\t--snapshot-every=N|Ts\t\tframe every N iterations or T seconds (default 1000)" << endl;
+    cout << "\t--snapshot-downsample=F\t\tframes keep every F-th cell of every F-th row (default 1)" << endl;
+    cout << "\t--ensemble=LIST\t\t\tsolve the instances of LIST, one \"INPUT_PATH OUTPUT_PATH\" line each, in"
+         << " parallel groups" << endl;
+    cout << "\t--group-size=N\t\t\tranks per ensemble group (default sized to the smallest instance)" << endl;
+    cout << "\t--profile[=PATH]\t\tprint min/avg/max phase times and MLUPS over the ranks, PATH gets JSON" << endl;
+    cout << "\t--restart=PATH\t\t\tstart from a checkpoint or raw output of a plate of the same size" << endl;
+    cout << "\t--warm-start[=off]\t\tstart from coarse solves interpolated to the plate instead of 128 (default off)"
+         << endl << endl;
+    cout << "Hybrid runs use one rank per socket or node, e.g." << endl;
+    cout << "\tmpirun --map-by socket --bind-to socket -x OMP_NUM_THREADS=8 " << program << " ..." << endl << endl;
 }
 
 MPI_Datatype CreateMpiSpotType() {
@@ -112,266 +96,116 @@ MPI_Datatype CreateMpiSpotType() {
 
 MPI_Datatype CreateMpiProblemType() {
     MPI_Datatype problem_type;
-    int lengths[4] = {1, 1, 1, 1};
+    int lengths[2] = {1, 1};
 
-    MPI_Aint displacements[4];
+    MPI_Aint displacements[2];
     Problem dummy_problem = {};
     MPI_Aint base_address;
     MPI_Get_address(&dummy_problem, &base_address);
     MPI_Get_address(&dummy_problem.width, &displacements[0]);
     MPI_Get_address(&dummy_problem.height, &displacements[1]);
-    MPI_Get_address(&dummy_problem.rootSize, &displacements[2]);
-    MPI_Get_address(&dummy_problem.slaveSize, &displacements[3]);
     displacements[0] = MPI_Aint_diff(displacements[0], base_address);
     displacements[1] = MPI_Aint_diff(displacements[1], base_address);
-    displacements[2] = MPI_Aint_diff(displacements[2], base_address);
-    displacements[3] = MPI_Aint_diff(displacements[3], base_address);
-    MPI_Datatype types[4] = {MPI_INT, MPI_INT, MPI_INT, MPI_INT};
+    MPI_Datatype types[2] = {MPI_INT, MPI_INT};
 
-    MPI_Type_create_struct(4, lengths, displacements, types, &problem_type);
+    MPI_Type_create_struct(2, lengths, displacements, types, &problem_type);
     MPI_Type_commit(&problem_type);
 
     return problem_type;
 }
 
-vector<Spot> distributeSpots(const vector<vector<Spot>> &chunkedSpots, MPI_Datatype MPI_SPOT_TYPE) {
-    for (int i = 1; i < chunkedSpots.size(); ++i) {
-        int size = chunkedSpots[i].size();
-        MPI_Send(&size, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
-
-        if (size > 0)
-            MPI_Send(&chunkedSpots[i][0],
-                     size,
-                     MPI_SPOT_TYPE,
-                     i,
-                     0,
-                     MPI_COMM_WORLD);
-
+// Scatters the spots of the root, bucketed by rank with the given counts, to every rank.
+vector<Spot> scatterSpots(const vector<Spot> &buckets, const vector<int> &counts, MPI_Datatype MPI_SPOT_TYPE,
+                          MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    vector<int> displacements(size, 0);
+    if (rank == ROOT_PROCESS) {
+        for (int i = 1; i < size; ++i)
+            displacements[i] = displacements[i - 1] + counts[i - 1];
     }
 
-    return chunkedSpots[0];
-}
-
-vector<Spot> receiveSpots(MPI_Datatype MPI_SPOT_TYPE) {
-    int size;
-
-    MPI_Recv(&size, 1, MPI_INT, 0, MPI_ANY_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    int count;
+    MPI_Scatter(counts.data(), 1, MPI_INT, &count, 1, MPI_INT, ROOT_PROCESS, comm);
 
-    if (size < 1)
-        return vector<Spot>(0);
-
-    vector<Spot> spots(size);
-
-    MPI_Recv(&spots[0],
-             size,
-             MPI_SPOT_TYPE,
-             0,
-             MPI_ANY_TAG,
-             MPI_COMM_WORLD,
-             MPI_STATUS_IGNORE);
+    vector<Spot> spots(count);
+    MPI_Scatterv(buckets.data(),
+                 counts.data(),
+                 displacements.data(),
+                 MPI_SPOT_TYPE,
+                 spots.data(),
+                 count,
+                 MPI_SPOT_TYPE,
+                 ROOT_PROCESS,
+                 comm);
 
     return spots;
 }
 
-float calculateIteration(vector<vector<float>> &matrix, const vector<vector<bool>> &isSpot, const Problem &problem, const int &myRank,
-                         const int &worldSize) {
-    float diff = 0;
-
-    vector<float> lineAfterMine(0);
-    vector<float> lineBeforeMine(0);
-
-    if (myRank + 1 < worldSize) {
-        /*cout << "CPU: " << myRank << " sending my last line to " << myRank + 1 << " receving lineAfterMine from "
-             << myRank + 1 << endl;*/
-        lineAfterMine = vector<float>(problem.width);
-
-        MPI_Sendrecv(&matrix[matrix.size() - 1][0],
-                     problem.width,
-                     MPI_FLOAT,
-                     myRank + 1,
-                     1,
-                     &lineAfterMine[0],
-                     problem.width,
-                     MPI_FLOAT,
-                     myRank + 1,
-                     2,
-                     MPI_COMM_WORLD,
-                     MPI_STATUS_IGNORE);
-    }
-
-    if (myRank - 1 >= 0) {
-        /*cout << "CPU: " << myRank << " sending my last line to " << myRank - 1 << " receving lineAfterMine from "
-             << myRank - 1 << endl;*/
-        lineBeforeMine = vector<float>(problem.width);
-
-        MPI_Sendrecv(&matrix[0][0],
-                     problem.width,
-                     MPI_FLOAT,
-                     myRank - 1,
-                     2,
-                     &lineBeforeMine[0],
-                     problem.width,
-                     MPI_FLOAT,
-                     myRank - 1,
-                     1,
-                     MPI_COMM_WORLD,
-                     MPI_STATUS_IGNORE);
-    }
-
-
-    /*stringstream ss;
-    ss << "CPU: " << myRank << " - LAM - " << lineAfterMine.size() << " - " << lineAfterMine.empty() << " - ";
-    for (auto foo: lineAfterMine) {
-        ss << foo << ";";
-    }
-    ss << endl;
-    cout << ss.str();
-
-    stringstream ss2;
-    ss2 << "CPU: " << myRank << " - LBM - " << lineBeforeMine.size() << " - " << lineBeforeMine.empty() << " - ";
-    for (auto foo: lineBeforeMine) {
-        ss2 << foo << ";";
+// Sorts the spots into one contiguous bucket per rank, a spot goes to every block whose ghost cells of the given depth
+// contain it. Counts the spots first, so the buckets are filled in place without growing.
+void bucketSpots(const vector<Spot> &spots, const Decomposition &decomposition, int depth, vector<Spot> &buckets,
+                 vector<int> &counts) {
+    counts.assign(decomposition.size, 0);
+    vector<int> ranks;
+    for (auto &spot: spots) {
+        decomposition.ranksCovering(spot.mX, spot.mY, depth, ranks);
+        for (int rank: ranks)
+            counts[rank]++;
     }
-    ss2 << endl;
-    cout << ss2.str();*/
 
+    vector<size_t> next(decomposition.size, 0);
+    for (int rank = 1; rank < decomposition.size; ++rank)
+        next[rank] = next[rank - 1] + counts[rank - 1];
+    buckets.resize(next.back() + counts.back());
 
-    //cout << "I HAVE SEND AND RECEIVE EVERYTHING!" << endl;
-
-    MPI_Barrier(MPI_COMM_WORLD);
-
-    for (int y = 0; y < matrix.size(); ++y) {
-        for (int x = 0; x < problem.width; ++x) {
-            if (isSpot[y][x])
-                continue;
-
-            float sum = 0;
-            sum += matrix[y][x];
-
-            float count = 1;
-
-            //Left
-            if (x > 0) {
-                sum += matrix[y][x - 1];
-                count++;
-            }
-
-            //Right
-            if (x < problem.width - 1) {
-                sum += matrix[y][x + 1];
-                count++;
-            }
-
-            //Top
-            if (y > 0) {
-                sum += matrix[y - 1][x];
-                count++;
-            } else if (y == 0 && !lineBeforeMine.empty()) {
-                sum += lineBeforeMine[x];
-                count++;
-            }
-
-            //Top right
-            if (y > 0 && x < problem.width - 1) {
-                sum += matrix[y - 1][x + 1];
-                count++;
-            } else if (y == 0 && x < problem.width - 1 && !lineBeforeMine.empty()) {
-                sum += lineBeforeMine[x + 1];
-                count++;
-            }
-
-            //Top left
-            if (y > 0 && x > 0) {
-                sum += matrix[y - 1][x - 1];
-                count++;
-            } else if (y == 0 && x > 0 && !lineBeforeMine.empty()) {
-                sum += lineBeforeMine[x - 1];
-                count++;
-            }
-
-            //Bottom
-            if (y < matrix.size() - 1) {
-                sum += matrix[y + 1][x];
-                count++;
-            } else if (y == matrix.size() - 1 && !lineAfterMine.empty()) {
-                sum += lineAfterMine[x];
-                count++;
-            }
-
-            //Bottom right
-            if (y < matrix.size() - 1 && x < problem.width - 1) {
-                sum += matrix[y + 1][x + 1];
-                count++;
-            } else if (y == matrix.size() - 1 && x < problem.width - 1 && !lineAfterMine.empty()) {
-                sum += lineAfterMine[x + 1];
-                count++;
-            }
-
-            //Bottom left
-            if (y < matrix.size() - 1 && x > 0) {
-                sum += matrix[y + 1][x - 1];
-                count++;
-            } else if (y == matrix.size() - 1 && x > 0 && !lineAfterMine.empty()) {
-                sum += lineAfterMine[x - 1];
-                count++;
-            }
-
-            /*cout << "X: " << x << "Y: " << y << " CPU: " << myRank << " SUM: " << sum << endl;
-            cout << "X: " << x << "Y: " << y << " CPU: " << myRank << " count: " << count << endl;*/
-
-            float newTemperature = sum / count;
-
-            diff = max(abs(matrix[y][x] - newTemperature), diff);
-
-            matrix[y][x] = newTemperature;
-        }
+    for (auto &spot: spots) {
+        decomposition.ranksCovering(spot.mX, spot.mY, depth, ranks);
+        for (int rank: ranks)
+            buckets[next[rank]++] = spot;
     }
-
-    //cout << "diff: " << diff << endl;
-
-    return diff;
 }
 
-void printMe(const std::vector<Spot> &spots, const int &rank) {
-    stringstream ss;
-
-    ss << "Content of processor with rank " << rank << ": {" << endl;
-    for (auto spot: spots) {
-        ss << "\tX:" << spot.mX << " Y:" << spot.mY << " Temperature:" << spot.mTemperature << endl;
+// Offsets of the process rows and columns that balance the cells left to compute, spots are never updated. Rank 0
+// holds the first row and column and gets rootShare of the work of a regular block.
+void balanceWork(const Problem &problem, vector<Spot> spots, int processRows, int processCols, float rootShare,
+                 vector<int> &rowStarts, vector<int> &colStarts) {
+    sort(spots.begin(), spots.end(), [](const Spot &a, const Spot &b) {
+        return tie(a.mY, a.mX) < tie(b.mY, b.mX);
+    });
+    spots.erase(unique(spots.begin(), spots.end()), spots.end());
+
+    vector<long> rowWork(problem.height, problem.width);
+    vector<long> colWork(problem.width, problem.height);
+    for (auto &spot: spots) {
+        rowWork[spot.mY]--;
+        colWork[spot.mX]--;
     }
-    ss << "}" << endl;
 
-    cout << ss.str();
+    // The share of the block is split between its row and column.
+    double axisShare = processRows > 1 && processCols > 1 ? sqrt(rootShare) : rootShare;
+    rowStarts = balancedStarts(rowWork, processRows, processRows > 1 ? axisShare : 1.0);
+    colStarts = balancedStarts(colWork, processCols, processCols > 1 ? axisShare : 1.0);
 }
 
 
-int main(int argc, char **argv) {
-    // Initialize MPI
-    MPI_Init(&argc, &argv);
-    int worldSize, myRank;
-    MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
-    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
-
-    if (argc == 1) {
-        if (myRank == 0) {
-            printHelpPage(argv[0]);
-        }
-        MPI_Finalize();
-        exit(0);
-    } else if (argc != 3) {
-        if (myRank == 0) {
-            printHelpPage(argv[0]);
-        }
-        MPI_Finalize();
-        exit(1);
-    }
+// Solves the instance at inputPath over the ranks of parent and writes the result to outputPath. An ensemble member
+// reports its result in a single line.
+void solveInstance(const Options &options, const string &inputPath, const string &outputPath, MPI_Comm parent,
+                   bool ensemble) {
+    int size, rank;
+    MPI_Comm_size(parent, &size);
+    MPI_Comm_rank(parent, &rank);
 
     // Read the input instance.
-    int width, height;  // Width and height of the matrix.
-    vector<Spot> spots; // Spots with permanent temperature.
-    if (myRank == 0) {
-        tie(width, height, spots) = readInstance(argv[1]);
+    double setupStart = MPI_Wtime();
+    Instance instance;
+    if (rank == ROOT_PROCESS) {
+        instance = readInstance(inputPath);
     }
+    const vector<Spot> &spots = instance.spots; // Spots with permanent temperature.
 
     high_resolution_clock::time_point start = high_resolution_clock::now();
 
@@ -385,156 +219,172 @@ int main(int argc, char **argv) {
 
     Problem problem;
 
-    if (myRank == ROOT_PROCESS) {
-        problem.height = height;
-        problem.width = width;
-        problem.slaveSize = height / worldSize;
-        problem.rootSize = height - (problem.slaveSize * (worldSize - 1));;
+    if (rank == ROOT_PROCESS) {
+        problem.height = instance.height;
+        problem.width = instance.width;
     }
 
-    MPI_Bcast(&problem, 1, MPI_PROBLEM_TYPE, ROOT_PROCESS, MPI_COMM_WORLD);
-
-    vector<vector<float>> matrix;
-    vector<Spot> assignedSpots;
-    vector<vector<bool>> isHotspot;
-    if (myRank == ROOT_PROCESS) {
-        //Calculate spots com
-        std::sort(spots.begin(), spots.end(), compareByY);
-        vector<vector<Spot>> chunkedSpots(worldSize, vector<Spot>());
-
-        int processor = 1;
-        for (auto &spot: spots) {
-            if (spot.mY < problem.rootSize)
-                chunkedSpots[0].push_back(spot);
-            else if (spot.mY) {
-                while (spot.mY >= problem.rootSize + processor * problem.slaveSize) {
-                    processor++;
-                }
-
-                chunkedSpots[processor].push_back(spot);
-            }
-        }
-
-        assignedSpots = distributeSpots(chunkedSpots, MPI_SPOT_TYPE);
-        printMe(assignedSpots, myRank);
+    MPI_Bcast(&problem, 1, MPI_PROBLEM_TYPE, ROOT_PROCESS, parent);
+
+    int processRows = options.processRows;
+    int processCols = options.processCols;
+    chooseProcessGrid(size, problem.width, problem.height, options.strips, processRows, processCols);
+    if (processRows > problem.height || processCols > problem.width)
+        throw runtime_error("The plate is too small for the process grid!\n");
+
+    vector<int> rowStarts(processRows + 1), colStarts(processCols + 1);
+    if (rank == ROOT_PROCESS)
+        balanceWork(problem, spots, processRows, processCols, options.rootShare, rowStarts, colStarts);
+    MPI_Bcast(rowStarts.data(), processRows + 1, MPI_INT, ROOT_PROCESS, parent);
+    MPI_Bcast(colStarts.data(), processCols + 1, MPI_INT, ROOT_PROCESS, parent);
+
+    Decomposition decomposition = createDecomposition(parent, problem.width, problem.height,
+                                                      processRows, processCols, rowStarts, colStarts);
+    MPI_Comm comm = decomposition.comm;
+    const Block &local = decomposition.local;
+
+    if (options.haloDepth > decomposition.smallestBlockSide())
+        throw runtime_error("The halo is deeper than the smallest block!\n");
+
+    //Calculate spots com
+    vector<Spot> buckets;
+    vector<int> counts;
+    if (rank == ROOT_PROCESS)
+        bucketSpots(spots, decomposition, options.haloDepth, buckets, counts);
+
+    vector<Spot> assignedSpots = scatterSpots(buckets, counts, MPI_SPOT_TYPE, comm);
+
+    //Create matrix
+    int depth = options.haloDepth;
+    Grid current(local.width, local.height, depth, 128);
+    StencilData stencil;
+    stencil.x0 = local.x0;
+    stencil.y0 = local.y0;
+    stencil.halo = depth;
+    stencil.stride = current.stride;
+    stencil.isSpot = vector<uint8_t>(current.size(), 0);
+
+    //Restore a checkpoint or interpolate coarse solves, the spots are imposed on top of it
+    long restartIteration = 0;
+    if (!options.restartPath.empty()) {
+        float restartDiff;
+        restartIteration = readCheckpoint(options.restartPath, current, decomposition, restartDiff);
+        if (rank == ROOT_PROCESS)
+            cout << "RESTART FROM ITERATION: " << restartIteration << " (MAX DIF " << restartDiff << ")" << endl;
+    } else if (options.warmStart) {
+        warmStart(spots, decomposition, options, current);
+    }
 
-        //Create matrix
-        matrix = vector<vector<float>>(problem.rootSize, vector<float>(problem.width, 128));
-        isHotspot = vector<vector<bool>>(problem.rootSize, vector<bool>(problem.width, false));
+    //Fill spots
+    for (auto spot: assignedSpots) {
+        int y = spot.mY - local.y0;
+        int x = spot.mX - local.x0;
+        current.row(y)[x] = spot.mTemperature;
+        stencil.isSpot[(size_t) (y + depth) * stencil.stride + x + depth] = 1;
+    }
 
-        //Fill spots
-        for (auto spot: assignedSpots) {
-            matrix[spot.mY - (problem.rootSize + (myRank - 1) * problem.slaveSize)][spot.mX] = spot.mTemperature;
-            isHotspot[spot.mY - (problem.rootSize + (myRank - 1) * problem.slaveSize)][spot.mX] = true;
-        }
-    } else {
-        assignedSpots = receiveSpots(MPI_SPOT_TYPE);
-        printMe(assignedSpots, myRank);
+    stencil.colWeight = axisWeights(local.x0 - depth, local.width + 2 * depth, problem.width);
+    stencil.rowWeight = axisWeights(local.y0 - depth, local.height + 2 * depth, problem.height);
+    stencil.kernel = selectStencilKernel(options.kernel);
 
-        matrix = vector<vector<float>>(problem.slaveSize, vector<float>(problem.width, 128));
-        isHotspot = vector<vector<bool>>(problem.slaveSize, vector<bool>(problem.width, false));
+    recordPhase(Phase::Setup, MPI_Wtime() - setupStart);
 
-        for (auto spot: assignedSpots) {
-            matrix[spot.mY - (problem.rootSize + (myRank - 1) * problem.slaveSize)][spot.mX] = spot.mTemperature;
-            isHotspot[spot.mY - (problem.rootSize + (myRank - 1) * problem.slaveSize)][spot.mX] = true;
-        }
+    float maxDif;
+    {
+        PhaseTimer timer(Phase::Solve);
+        maxDif = simulate(current, stencil, decomposition, options, restartIteration);
     }
 
-    float maxDif;
-    do {
-        float myDiff = calculateIteration(matrix, isHotspot, problem, myRank, worldSize);
-        vector<float> diffs(worldSize);
-
-        MPI_Allgather(&myDiff,
-                      1,
-                      MPI_FLOAT,
-                      &diffs[0],
-                      1,
-                      MPI_FLOAT,
-                      MPI_COMM_WORLD);
-
-        maxDif = *max_element(diffs.begin(), diffs.end());
-
-        if (myRank == ROOT_PROCESS) {
-            /*for (auto dif: diffs)
-                cout << dif << ";";
-            cout << endl;*/
-            //cout << "STEP MAX DIF: " << maxDif << endl;
-        }
+    if (rank == ROOT_PROCESS && !ensemble)
+        cout << "FINAL MAX DIF: " << maxDif << endl;
 
-    } while (maxDif >= 0.0001);
+    MPI_Barrier(parent);
 
-    if (myRank == ROOT_PROCESS)
-        cout << "FINAL MAX DIF: " << maxDif << endl;
+//-----------------------\\
 
-    vector<float> temperatures(problem.width * problem.height);
-
-    vector<float> message;
-    if (myRank == ROOT_PROCESS) {
-        message = vector<float>(problem.width * problem.rootSize);
-        int index = 0;
-        for (int y = 0; y < problem.rootSize; ++y) {
-            for (int x = 0; x < problem.width; ++x) {
-                message[index] = matrix[y][x];
-                index++;
-            }
-        }
-    } else {
-        message = vector<float>(problem.width * problem.slaveSize);
-        int index = 0;
-        for (int y = 0; y < problem.slaveSize; ++y) {
-            for (int x = 0; x < problem.width; ++x) {
-                message[index] = matrix[y][x];
-                index++;
-            }
-        }
+    double totalDuration = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+    if (rank == ROOT_PROCESS && !ensemble)
+        cout << "computational time: " << totalDuration << " s" << endl;
+    if (rank == ROOT_PROCESS && ensemble)
+        cout << inputPath << ": FINAL MAX DIF: " << maxDif << ", computational time: " << totalDuration << " s, ranks: "
+             << size << endl;
+
+    {
+        PhaseTimer timer(Phase::Output);
+        writeOutput(outputPath, options.format, current, decomposition);
     }
 
-    cout << "CPU " << myRank << " MESSAGE SIZE: " << message.size() << endl;
-
-//    if (myRank == 1){
-//        cout << "MESSAGE " << myRank << endl;
-//        for (auto fo: message) {
-//            cout << fo << ";";
-//        }
-//    }
-
-    //vector<float> buff(problem.width * problem.slaveSize * (worldSize));
-    MPI_Gather(&message[0],
-               message.size(),
-               MPI_FLOAT,
-               &temperatures[0],
-               message.size(),
-               MPI_FLOAT,
-               ROOT_PROCESS,
-               MPI_COMM_WORLD);
+    if (options.profile)
+        reportInstrumentation(decomposition, options, options.profilePath);
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    freeDecomposition(decomposition);
+    MPI_Type_free(&MPI_PROBLEM_TYPE);
+    MPI_Type_free(&MPI_SPOT_TYPE);
+}
+
+// Solves the instances of the ensemble list, each on the ranks of the group the scheduler hands it to.
+void solveEnsemble(const Options &options) {
+    double start = MPI_Wtime();
+    vector<EnsembleMember> members = readEnsemble(options.ensemblePath);
+    EnsembleScheduler scheduler(MPI_COMM_WORLD, members, options.groupSize, options.haloDepth);
 
-    /*if (myRank == ROOT_PROCESS) {
-        if (myRank == ROOT_PROCESS)
-            for (auto fo: temperatures) {
-                cout << fo << ";";
-            }
-    }*/
+    for (int index = scheduler.next(); index >= 0; index = scheduler.next()) {
+        if (scheduler.instance() != MPI_COMM_NULL)
+            solveInstance(options, members[index].inputPath, members[index].outputPath, scheduler.instance(), true);
+    }
 
-    //cout << "DONE";
+    MPI_Barrier(MPI_COMM_WORLD);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == ROOT_PROCESS)
+        cout << "ENSEMBLE: " << members.size() << " instances on " << scheduler.groupCount() << " groups of "
+             << scheduler.groupSize() << " ranks, " << MPI_Wtime() - start << " s" << endl;
+}
 
-// TODO: Fill this array on processor with rank 0. It must have height * width elements and it contains the
-// linearized matrix of temperatures in row-major order
-// (see https://en.wikipedia.org/wiki/Row-_and_column-major_order)
 
+int main(int argc, char **argv) {
+    // Initialize MPI, only the master thread of each rank communicates.
+    int threadSupport;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadSupport);
+    int worldSize, myRank;
+    MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
 
-//-----------------------\\
+    if (argc == 1) {
+        if (myRank == 0) {
+            printHelpPage(argv[0]);
+        }
+        MPI_Finalize();
+        exit(0);
+    }
 
-    double totalDuration = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
-    cout << "computational time: " << totalDuration << " s" <<   endl;
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const exception &e) {
+        if (myRank == 0) {
+            cerr << e.what();
+            printHelpPage(argv[0]);
+        }
+        MPI_Finalize();
+        exit(1);
+    }
+
+#ifdef _OPENMP
+    if (options.threads > 0)
+        omp_set_num_threads(options.threads);
 
-    if (myRank == 0) {
-        string outputFileName(argv[2]);
-        writeOutput(myRank, width, height, outputFileName, temperatures
-        );
+    if (threadSupport < MPI_THREAD_FUNNELED && omp_get_max_threads() > 1) {
+        if (myRank == 0)
+            cerr << "MPI does not support MPI_THREAD_FUNNELED, running with one thread per rank." << endl;
+        omp_set_num_threads(1);
     }
+#endif
+
+    if (!options.ensemblePath.empty())
+        solveEnsemble(options);
+    else
+        solveInstance(options, options.inputPath, options.outputPath, MPI_COMM_WORLD, false);
 
     MPI_Finalize();
 
@@ -0,0 +1,198 @@
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Instance.h"
+
+// Read-only memory map of a whole file, unmapped when it goes out of scope.
+class MappedFile {
+private:
+    const char *bytes = nullptr;
+    size_t length = 0;
+
+public:
+    explicit MappedFile(const std::string &path) {
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            throw std::runtime_error("It is not possible to open instance file!\n");
+
+        struct stat status = {};
+        if (fstat(descriptor, &status) != 0) {
+            close(descriptor);
+            throw std::runtime_error("It is not possible to open instance file!\n");
+        }
+
+        length = (size_t) status.st_size;
+        if (length > 0) {
+            void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapping == MAP_FAILED) {
+                close(descriptor);
+                throw std::runtime_error("It is not possible to map instance file!\n");
+            }
+            bytes = (const char *) mapping;
+            madvise(mapping, length, MADV_SEQUENTIAL);
+        }
+        close(descriptor);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        if (bytes)
+            munmap((void *) bytes, length);
+    }
+
+    const char *begin() const { return bytes; }
+
+    const char *end() const { return bytes + length; }
+
+    size_t size() const { return length; }
+};
+
+// Parses the next integer after whitespace, returns false at the end of the text.
+static bool nextInt(const char *&position, const char *end, int &value) {
+    while (position < end && (*position == ' ' || *position == '\t' || *position == '\n' || *position == '\r'))
+        position++;
+    if (position == end)
+        return false;
+
+    auto result = std::from_chars(position, end, value);
+    if (result.ec != std::errc())
+        throw std::runtime_error("Malformed instance file!\n");
+    position = result.ptr;
+    return true;
+}
+
+static Instance parseText(const MappedFile &file) {
+    Instance instance;
+    const char *position = file.begin();
+    const char *end = file.end();
+
+    if (!nextInt(position, end, instance.width) || !nextInt(position, end, instance.height))
+        throw std::runtime_error("Malformed instance file!\n");
+
+    int x, y, temperature;
+    while (nextInt(position, end, x)) {
+        if (!nextInt(position, end, y) || !nextInt(position, end, temperature))
+            throw std::runtime_error("Malformed instance file!\n");
+        instance.spots.push_back({x, y, (float) temperature});
+    }
+
+    return instance;
+}
+
+static Instance parseBinary(const MappedFile &file) {
+    const size_t magic = sizeof(BINARY_INSTANCE_MAGIC) - 1;
+    const size_t headerSize = magic + 2 * sizeof(int32_t) + sizeof(uint64_t);
+    const size_t recordSize = 2 * sizeof(int32_t) + sizeof(float);
+
+    if (file.size() < headerSize)
+        throw std::runtime_error("Malformed instance file!\n");
+
+    Instance instance;
+    int32_t size[2];
+    uint64_t count;
+    std::memcpy(size, file.begin() + magic, sizeof(size));
+    std::memcpy(&count, file.begin() + magic + sizeof(size), sizeof(count));
+    instance.width = size[0];
+    instance.height = size[1];
+
+    if ((file.size() - headerSize) / recordSize < count)
+        throw std::runtime_error("Malformed instance file!\n");
+
+    instance.spots.resize(count);
+    const char *record = file.begin() + headerSize;
+    for (auto &spot: instance.spots) {
+        std::memcpy(&spot.mX, record, sizeof(int32_t));
+        std::memcpy(&spot.mY, record + sizeof(int32_t), sizeof(int32_t));
+        std::memcpy(&spot.mTemperature, record + 2 * sizeof(int32_t), sizeof(float));
+        record += recordSize;
+    }
+
+    return instance;
+}
+
+Instance readInstance(const std::string &path) {
+    MappedFile file(path);
+
+    const size_t magic = sizeof(BINARY_INSTANCE_MAGIC) - 1;
+    Instance instance = file.size() >= magic && std::memcmp(file.begin(), BINARY_INSTANCE_MAGIC, magic) == 0
+                        ? parseBinary(file)
+                        : parseText(file);
+
+    for (auto &spot: instance.spots) {
+        if (spot.mX < 0 || spot.mX >= instance.width || spot.mY < 0 || spot.mY >= instance.height)
+            throw std::runtime_error("Spot [" + std::to_string(spot.mX) + ", " + std::to_string(spot.mY) +
+                                     "] lies outside of the plate!\n");
+    }
+
+    return instance;
+}
+
+void readInstanceSize(const std::string &path, int &width, int &height) {
+    MappedFile file(path);
+
+    const size_t magic = sizeof(BINARY_INSTANCE_MAGIC) - 1;
+    if (file.size() >= magic && std::memcmp(file.begin(), BINARY_INSTANCE_MAGIC, magic) == 0) {
+        int32_t size[2];
+        if (file.size() < magic + sizeof(size))
+            throw std::runtime_error("Malformed instance file!\n");
+        std::memcpy(size, file.begin() + magic, sizeof(size));
+        width = size[0];
+        height = size[1];
+        return;
+    }
+
+    const char *position = file.begin();
+    if (!nextInt(position, file.end(), width) || !nextInt(position, file.end(), height))
+        throw std::runtime_error("Malformed instance file!\n");
+}
+
+void writeBinaryInstance(const std::string &path, const Instance &instance) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("It is not possible to open instance file!\n");
+
+    int32_t size[2] = {instance.width, instance.height};
+    uint64_t count = instance.spots.size();
+    file.write(BINARY_INSTANCE_MAGIC, sizeof(BINARY_INSTANCE_MAGIC) - 1);
+    file.write((const char *) size, sizeof(size));
+    file.write((const char *) &count, sizeof(count));
+
+    for (auto &spot: instance.spots) {
+        int32_t position[2] = {spot.mX, spot.mY};
+        file.write((const char *) position, sizeof(position));
+        file.write((const char *) &spot.mTemperature, sizeof(float));
+    }
+
+    if (!file)
+        throw std::runtime_error("It is not possible to write instance file!\n");
+}
+
+void writeTextInstance(const std::string &path, const Instance &instance) {
+    std::ofstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("It is not possible to open instance file!\n");
+
+    std::string text = std::to_string(instance.width) + "\n" + std::to_string(instance.height) + "\n";
+    for (auto &spot: instance.spots) {
+        text += std::to_string(spot.mX) + " " + std::to_string(spot.mY) + " " +
+                std::to_string((int) std::lround(spot.mTemperature)) + "\n";
+        if (text.size() >= (1 << 20)) {
+            file << text;
+            text.clear();
+        }
+    }
+    file << text;
+
+    if (!file)
+        throw std::runtime_error("It is not possible to write instance file!\n");
+}
@@ -0,0 +1,43 @@
+#ifndef HW2_INSTANCE_H
+#define HW2_INSTANCE_H
+
+#include <string>
+#include <vector>
+
+// Spot with permanent temperature on coordinates [x,y].
+struct Spot {
+    int mX;
+    int mY;
+    float mTemperature;
+
+    bool operator==(const Spot &b) const {
+        return (mX == b.mX) && (mY == b.mY);
+    }
+};
+
+// Plate size and spots of an instance.
+struct Instance {
+    int width = 0;
+    int height = 0;
+    std::vector<Spot> spots;
+};
+
+// First bytes of a binary instance: the magic, int32 width and height, uint64 spot count and the spots as int32 x,
+// int32 y and float32 temperature records, all in native byte order.
+#define BINARY_INSTANCE_MAGIC "HDI1"
+
+// Reads a text instance (width, height and one "x y temperature" line per spot) or a binary one, told apart by the
+// magic. The file is mapped into memory and the numbers are parsed in place. Throws when the file cannot be read or
+// is malformed.
+Instance readInstance(const std::string &path);
+
+// Reads only the plate size of a text or binary instance. Throws when the file cannot be read or is malformed.
+void readInstanceSize(const std::string &path, int &width, int &height);
+
+// Writes the instance in the binary format, throws when the file cannot be written.
+void writeBinaryInstance(const std::string &path, const Instance &instance);
+
+// Writes the instance in the text format with the temperatures rounded, throws when the file cannot be written.
+void writeTextInstance(const std::string &path, const Instance &instance);
+
+#endif //HW2_INSTANCE_H
@@ -0,0 +1,169 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "Instance.h"
+
+using namespace std;
+
+// Shape of the generated instance.
+struct GeneratorOptions {
+    int width = 0;
+    int height = 0;
+    long spots = 0;
+    string outputPath;
+
+    unsigned seed = 1;
+
+    // Spots gather around this many random centres, 0 spreads them uniformly over the plate.
+    int clusters = 0;
+    // Standard deviation of the distance of a spot from its centre in cells.
+    double clusterRadius = 16;
+
+    int minTemperature = 0;
+    int maxTemperature = 255;
+
+    bool binary = false;
+};
+
+void printHelpPage(char *program) {
+    cout << "Generates a random heat diffusion instance, the same seed gives the same instance." << endl;
+    cout << endl << "Usage:" << endl;
+    cout << "\t" << program << " WIDTH HEIGHT SPOTS OUTPUT_PATH [OPTIONS]" << endl << endl;
+    cout << "Options:" << endl;
+    cout << "\t--seed=N\t\t\tseed of the random generator (default 1)" << endl;
+    cout << "\t--clusters=K\t\t\tgather the spots around K random centres (default 0, uniform)" << endl;
+    cout << "\t--cluster-radius=R\t\tstandard deviation of a spot from its centre in cells (default 16)" << endl;
+    cout << "\t--temperature=MIN:MAX\t\trange of the spot temperatures (default 0:255)" << endl;
+    cout << "\t--binary\t\t\twrite the binary instance format" << endl << endl;
+}
+
+static int parseNonNegative(const string &name, const string &value) {
+    int number;
+    try {
+        number = stoi(value);
+    } catch (const exception &) {
+        throw runtime_error("Option " + name + " expects a number, got '" + value + "'!\n");
+    }
+
+    if (number < 0)
+        throw runtime_error("Option " + name + " must not be negative!\n");
+
+    return number;
+}
+
+static GeneratorOptions parseGeneratorOptions(int argc, char **argv) {
+    GeneratorOptions options;
+    vector<string> positional;
+
+    for (int i = 1; i < argc; ++i) {
+        string argument(argv[i]);
+
+        if (argument.rfind("--", 0) != 0) {
+            positional.push_back(argument);
+            continue;
+        }
+
+        auto separator = argument.find('=');
+        string name = argument.substr(2, separator == string::npos ? string::npos : separator - 2);
+        string value = separator == string::npos ? "" : argument.substr(separator + 1);
+
+        if (name == "seed")
+            options.seed = (unsigned) parseNonNegative("--seed", value);
+        else if (name == "clusters")
+            options.clusters = parseNonNegative("--clusters", value);
+        else if (name == "cluster-radius")
+            options.clusterRadius = parseNonNegative("--cluster-radius", value);
+        else if (name == "temperature" && value.find(':') != string::npos) {
+            options.minTemperature = parseNonNegative("--temperature", value.substr(0, value.find(':')));
+            options.maxTemperature = parseNonNegative("--temperature", value.substr(value.find(':') + 1));
+        } else if (name == "binary")
+            options.binary = true;
+        else
+            throw runtime_error("Unknown option '" + argument + "'!\n");
+    }
+
+    if (positional.size() != 4)
+        throw runtime_error("Expected WIDTH, HEIGHT, SPOTS and OUTPUT_PATH!\n");
+
+    options.width = parseNonNegative("WIDTH", positional[0]);
+    options.height = parseNonNegative("HEIGHT", positional[1]);
+    options.spots = parseNonNegative("SPOTS", positional[2]);
+    options.outputPath = positional[3];
+
+    if (options.width < 1 || options.height < 1)
+        throw runtime_error("The plate must not be empty!\n");
+    if (options.spots > (long) options.width * options.height)
+        throw runtime_error("There are more spots than cells!\n");
+    if (options.minTemperature > options.maxTemperature)
+        throw runtime_error("Option --temperature expects MIN <= MAX!\n");
+
+    return options;
+}
+
+// Draws distinct spot positions, around the cluster centres if there are any. A position that falls off the plate or
+// onto a taken cell is drawn again, once clustered draws keep failing the rest of the spots is spread uniformly.
+static Instance randomInstance(mt19937 &randGen, const GeneratorOptions &options) {
+    Instance instance;
+    instance.width = options.width;
+    instance.height = options.height;
+    instance.spots.reserve(options.spots);
+
+    uniform_int_distribution<int> distX(0, options.width - 1);
+    uniform_int_distribution<int> distY(0, options.height - 1);
+    uniform_int_distribution<int> distTemperature(options.minTemperature, options.maxTemperature);
+    normal_distribution<double> distOffset(0.0, options.clusterRadius);
+
+    vector<pair<int, int>> centres;
+    for (int i = 0; i < options.clusters; ++i)
+        centres.emplace_back(distX(randGen), distY(randGen));
+    uniform_int_distribution<int> distCentre(0, max(options.clusters - 1, 0));
+
+    unordered_set<int64_t> taken;
+    long failures = 0;
+    while ((long) instance.spots.size() < options.spots) {
+        int x, y;
+        if (!centres.empty() && failures < 100 + 10 * options.spots) {
+            auto &centre = centres[distCentre(randGen)];
+            x = centre.first + (int) lround(distOffset(randGen));
+            y = centre.second + (int) lround(distOffset(randGen));
+        } else {
+            x = distX(randGen);
+            y = distY(randGen);
+        }
+
+        if (x < 0 || x >= options.width || y < 0 || y >= options.height ||
+            !taken.insert((int64_t) y * options.width + x).second) {
+            failures++;
+            continue;
+        }
+
+        instance.spots.push_back({x, y, (float) distTemperature(randGen)});
+    }
+
+    return instance;
+}
+
+int main(int argc, char **argv) {
+    GeneratorOptions options;
+    try {
+        options = parseGeneratorOptions(argc, argv);
+    } catch (const exception &e) {
+        cerr << e.what();
+        printHelpPage(argv[0]);
+        return 1;
+    }
+
+    mt19937 randGen(options.seed);
+    Instance instance = randomInstance(randGen, options);
+
+    if (options.binary)
+        writeBinaryInstance(options.outputPath, instance);
+    else
+        writeTextInstance(options.outputPath, instance);
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <mpi.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "Instrumentation.h"
+#include "Options.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Bytes a cell update moves at least: the old value, the new one and the spot mask. The neighbours come from cache.
+const double BYTES_PER_UPDATE = 2 * sizeof(float) + 1;
+
+static const char *PHASE_NAMES[PHASE_COUNT] = {"setup", "solve", "halo", "reduction", "checkpoint", "snapshot", "output"};
+
+static double phaseSeconds[PHASE_COUNT] = {};
+static long sweeps = 0;
+static double cellUpdates = 0;
+
+PhaseTimer::PhaseTimer(Phase phase) : phase(phase), begin(MPI_Wtime()) {
+}
+
+PhaseTimer::~PhaseTimer() {
+    recordPhase(phase, MPI_Wtime() - begin);
+}
+
+void recordPhase(Phase phase, double seconds) {
+    phaseSeconds[(int) phase] += seconds;
+}
+
+void recordSweep(long cells) {
+    sweeps++;
+    cellUpdates += (double) cells;
+}
+
+// Values of one rank: the phases, compute, sweeps, updates and MLUPS of the compute time.
+const int COMPUTE = PHASE_COUNT;
+const int SWEEPS = PHASE_COUNT + 1;
+const int UPDATES = PHASE_COUNT + 2;
+const int MLUPS = PHASE_COUNT + 3;
+const int VALUES = PHASE_COUNT + 4;
+
+static const char *valueName(int value) {
+    switch (value) {
+        case COMPUTE:
+            return "compute";
+        case SWEEPS:
+            return "sweeps";
+        case UPDATES:
+            return "updates";
+        case MLUPS:
+            return "mlups";
+        default:
+            return PHASE_NAMES[value];
+    }
+}
+
+struct Spread {
+    double min;
+    double avg;
+    double max;
+};
+
+static Spread spreadOf(const std::vector<double> &all, int value, int ranks) {
+    Spread spread = {all[value], 0, all[value]};
+    for (int rank = 0; rank < ranks; ++rank) {
+        double x = all[(size_t) rank * VALUES + value];
+        spread.min = std::min(x, spread.min);
+        spread.max = std::max(x, spread.max);
+        spread.avg += x / ranks;
+    }
+    return spread;
+}
+
+static void writeJson(const std::string &path, const std::vector<double> &all, int ranks, const Options &options,
+                      const Decomposition &decomposition, double mlups) {
+    std::ofstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("It is not possible to open profile file!\n");
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    file << "{\n";
+    file << "  \"width\": " << decomposition.width << ",\n";
+    file << "  \"height\": " << decomposition.height << ",\n";
+    file << "  \"ranks\": " << ranks << ",\n";
+    file << "  \"threads\": " << threads << ",\n";
+    file << "  \"scheme\": \"" << schemeName(options.scheme) << "\",\n";
+    file << "  \"mlups\": " << mlups << ",\n";
+    file << "  \"gbPerSecond\": " << mlups * BYTES_PER_UPDATE / 1000 << ",\n";
+
+    file << "  \"summary\": {\n";
+    for (int value = 0; value < VALUES; ++value) {
+        Spread spread = spreadOf(all, value, ranks);
+        file << "    \"" << valueName(value) << "\": {\"min\": " << spread.min << ", \"avg\": " << spread.avg
+             << ", \"max\": " << spread.max << "}" << (value + 1 < VALUES ? "," : "") << "\n";
+    }
+    file << "  },\n";
+
+    file << "  \"perRank\": [\n";
+    for (int rank = 0; rank < ranks; ++rank) {
+        file << "    {\"rank\": " << rank;
+        for (int value = 0; value < VALUES; ++value)
+            file << ", \"" << valueName(value) << "\": " << all[(size_t) rank * VALUES + value];
+        file << "}" << (rank + 1 < ranks ? "," : "") << "\n";
+    }
+    file << "  ]\n";
+    file << "}\n";
+
+    if (!file)
+        throw std::runtime_error("It is not possible to write profile file!\n");
+}
+
+void reportInstrumentation(const Decomposition &decomposition, const Options &options, const std::string &jsonPath) {
+    double mine[VALUES];
+    std::copy(phaseSeconds, phaseSeconds + PHASE_COUNT, mine);
+    mine[COMPUTE] = std::max(phaseSeconds[(int) Phase::Solve] - phaseSeconds[(int) Phase::Halo] -
+                             phaseSeconds[(int) Phase::Reduction] - phaseSeconds[(int) Phase::Checkpoint] -
+                             phaseSeconds[(int) Phase::Snapshot], 0.0);
+    mine[SWEEPS] = (double) sweeps;
+    mine[UPDATES] = cellUpdates;
+    mine[MLUPS] = mine[COMPUTE] > 0 ? cellUpdates / mine[COMPUTE] / 1e6 : 0;
+
+    int ranks = decomposition.size;
+    std::vector<double> all(decomposition.rank == 0 ? (size_t) ranks * VALUES : 0);
+    MPI_Gather(mine, VALUES, MPI_DOUBLE, all.data(), VALUES, MPI_DOUBLE, 0, decomposition.comm);
+    if (decomposition.rank != 0)
+        return;
+
+    // The plate advances at the pace of the slowest rank.
+    double updates = spreadOf(all, UPDATES, ranks).avg * ranks;
+    double solve = spreadOf(all, (int) Phase::Solve, ranks).max;
+    double mlups = solve > 0 ? updates / solve / 1e6 : 0;
+
+    std::ostringstream table;
+    table << "PROFILE (seconds, sweeps, MLUPS of the compute time)\tmin\tavg\tmax" << std::endl;
+    for (int value = 0; value < VALUES; ++value) {
+        if (value == UPDATES)
+            continue;
+        Spread spread = spreadOf(all, value, ranks);
+        table << valueName(value) << "\t" << spread.min << "\t" << spread.avg << "\t" << spread.max << std::endl;
+    }
+    table << "MLUPS: " << mlups << ", GB/s: " << mlups * BYTES_PER_UPDATE / 1000 << std::endl;
+    std::cout << table.str();
+
+    if (!jsonPath.empty())
+        writeJson(jsonPath, all, ranks, options, decomposition, mlups);
+}
@@ -0,0 +1,51 @@
+#ifndef HW2_INSTRUMENTATION_H
+#define HW2_INSTRUMENTATION_H
+
+#include <string>
+#include "Decomposition.h"
+
+struct Options;
+
+// Phases of a run whose wall time every rank records. Compute is not timed itself, it is the solve minus the halo,
+// reduction, checkpoint and snapshot time spent inside it.
+enum class Phase {
+    Setup,
+    Solve,
+    Halo,
+    Reduction,
+    Checkpoint,
+    Snapshot,
+    Output
+};
+
+const int PHASE_COUNT = 7;
+
+// Adds the wall time of its scope to the phase of this rank. MPI is funneled through the master thread and only the
+// master thread records, so the halo and reduction times are the time the master thread waited for MPI.
+class PhaseTimer {
+private:
+    Phase phase;
+    double begin;
+
+public:
+    explicit PhaseTimer(Phase phase);
+
+    PhaseTimer(const PhaseTimer &) = delete;
+
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+    ~PhaseTimer();
+};
+
+// Adds seconds to the phase of this rank.
+void recordPhase(Phase phase, double seconds);
+
+// Counts a sweep over cells owned cells of this rank.
+void recordSweep(long cells);
+
+// Collective over decomposition.comm. Gathers the phases and sweeps of all ranks on rank 0, which prints their min,
+// avg and max along with the cell updates per second (MLUPS) and the memory traffic they imply, and writes them with
+// the values of every rank as JSON to jsonPath unless it is empty.
+void reportInstrumentation(const Decomposition &decomposition, const Options &options, const std::string &jsonPath);
+
+#endif //HW2_INSTRUMENTATION_H
@@ -0,0 +1,399 @@
+#include <cmath>
+#include <algorithm>
+#include "Multigrid.h"
+#include "Checkpoint.h"
+#include "Snapshot.h"
+#include "Instrumentation.h"
+
+// Levels are coarsened until they have at most this many cells, the coarsest one is solved by plain sweeps.
+const long COARSEST_CELLS = 64;
+const int COARSEST_SWEEPS = 100;
+
+// Distributed levels are gathered on rank 0 once a block side drops below this.
+const int GATHER_BLOCK_SIDE = 8;
+
+// Gauss-Seidel sweeps per cycle on the fine grid and before and after the correction on the coarse levels.
+const int FINE_SWEEPS = 2;
+const int COARSE_SWEEPS = 2;
+
+// Coarse grid corrections per level and cycle. Two make a W-cycle, which keeps the number of cycles independent of
+// the grid size with aggregation, where a V-cycle slowly degrades with the number of levels.
+const int COARSE_VISITS = 2;
+
+static int plane(int dy, int dx) {
+    return (dy + 1) * 3 + dx + 1;
+}
+
+// Aggregate of the fine index i of a block of the given length. Cells of the ghost ring belong to the first or last
+// aggregate of the neighbouring block, which is the ghost ring of the coarse block.
+static int aggregateOf(int i, int length) {
+    if (i < 0)
+        return -1;
+    if (i >= length)
+        return (length + 1) / 2;
+    return i / 2;
+}
+
+static MultigridLevel createLevel(const Decomposition &decomposition) {
+    MultigridLevel level;
+    level.decomposition = decomposition;
+
+    int width = decomposition.local.width;
+    int height = decomposition.local.height;
+    level.coefficients = std::vector<Grid>(9, Grid(width, height, 0, 0.0f));
+    level.correction = Grid(width, height, 1, 0.0f);
+    level.rhs = Grid(width, height, 0, 0.0f);
+    level.residual = Grid(width, height, 0, 0.0f);
+    level.halo.reset(new HaloExchange(level.decomposition, level.correction));
+    return level;
+}
+
+// Galerkin operator of the 2x2 aggregates: a coupling of two fine cells inside one aggregate leaves its diagonal, the
+// others add up to the weight of the neighbouring aggregate. coefficient(x, y, dy, dx) is the fine operator.
+template<typename Coefficient>
+static void buildOperator(MultigridLevel &coarse, int fineWidth, int fineHeight, const Coefficient &coefficient) {
+    for (int y = 0; y < fineHeight; ++y) {
+        int coarseY = y / 2;
+        for (int x = 0; x < fineWidth; ++x) {
+            float diagonal = coefficient(x, y, 0, 0);
+            if (diagonal == 0)
+                continue;
+
+            int coarseX = x / 2;
+            float &coarseDiagonal = coarse.coefficients[plane(0, 0)].row(coarseY)[coarseX];
+            coarseDiagonal += diagonal;
+
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    if (dy == 0 && dx == 0)
+                        continue;
+
+                    float weight = coefficient(x, y, dy, dx);
+                    if (weight == 0)
+                        continue;
+
+                    int toY = aggregateOf(y + dy, fineHeight) - coarseY;
+                    int toX = aggregateOf(x + dx, fineWidth) - coarseX;
+                    if (toY == 0 && toX == 0)
+                        coarseDiagonal -= weight;
+                    else
+                        coarse.coefficients[plane(toY, toX)].row(coarseY)[coarseX] += weight;
+                }
+            }
+        }
+    }
+}
+
+// Sum of the weighted neighbours of cell (x, y), the W e part of A e.
+static float neighbourSum(const MultigridLevel &level, const Grid &values, int x, int y) {
+    float sum = 0;
+    for (int dy = -1; dy <= 1; ++dy)
+        for (int dx = -1; dx <= 1; ++dx)
+            if (dy != 0 || dx != 0)
+                sum += level.coefficients[plane(dy, dx)].row(y)[x] * values.row(y + dy)[x + dx];
+    return sum;
+}
+
+static void exchange(MultigridLevel &level) {
+    level.halo->start(level.correction);
+    level.halo->finish();
+}
+
+// Four-colour Gauss-Seidel sweeps on A e = rhs, same ordering as on the fine grid.
+static void smooth(MultigridLevel &level, int sweeps) {
+    Grid &correction = level.correction;
+    const Block &block = level.decomposition.local;
+
+    for (int sweep = 0; sweep < sweeps; ++sweep) {
+        for (int colour = 0; colour < 4; ++colour) {
+            exchange(level);
+
+            int firstY = (block.y0 & 1) != (colour >> 1);
+            int firstX = (block.x0 & 1) != (colour & 1);
+
+#pragma omp parallel for schedule(static)
+            for (int y = firstY; y < block.height; y += 2) {
+                const float *diagonal = level.coefficients[plane(0, 0)].row(y);
+                const float *rhs = level.rhs.row(y);
+                float *row = correction.row(y);
+                for (int x = firstX; x < block.width; x += 2) {
+                    if (diagonal[x] != 0)
+                        row[x] = (rhs[x] + neighbourSum(level, correction, x, y)) / diagonal[x];
+                }
+            }
+        }
+    }
+}
+
+static void computeResidual(MultigridLevel &level) {
+    exchange(level);
+
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < level.residual.height; ++y) {
+        const float *diagonal = level.coefficients[plane(0, 0)].row(y);
+        const float *rhs = level.rhs.row(y);
+        const float *correction = level.correction.row(y);
+        float *residual = level.residual.row(y);
+        for (int x = 0; x < level.residual.width; ++x) {
+            residual[x] = diagonal[x] == 0
+                          ? 0.0f
+                          : rhs[x] - diagonal[x] * correction[x] + neighbourSum(level, level.correction, x, y);
+        }
+    }
+}
+
+// Sums the residual of the cells of every aggregate, fixed cells have a zero residual.
+static void restrictResidual(const Grid &residual, Grid &rhs) {
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < rhs.height; ++y) {
+        float *out = rhs.row(y);
+        std::fill(out, out + rhs.width, 0.0f);
+        for (int fineY = 2 * y; fineY < std::min(2 * y + 2, residual.height); ++fineY) {
+            const float *in = residual.row(fineY);
+            for (int x = 0; x < residual.width; ++x)
+                out[x / 2] += in[x];
+        }
+    }
+}
+
+// Adds scale times the correction of its aggregate to every free cell of fine.
+template<typename IsFree>
+static void prolongate(const Grid &correction, const float &scale, Grid &fine, const IsFree &isFree) {
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < fine.height; ++y) {
+        const float *in = correction.row(y / 2);
+        float *out = fine.row(y);
+        for (int x = 0; x < fine.width; ++x) {
+            if (isFree(x, y))
+                out[x] += scale * in[x / 2];
+        }
+    }
+}
+
+// Step length along the correction e that minimizes the energy norm of the error: e.rhs / e.Ae. With the Galerkin
+// operator this equals the step of the prolongated correction on the level above. Piecewise constant prolongation
+// makes too short corrections, the scaling recovers a convergence rate independent of the grid size.
+static float correctionScale(MultigridLevel &level) {
+    exchange(level);
+
+    double projection = 0;
+    double energy = 0;
+#pragma omp parallel for schedule(static) reduction(+:projection, energy)
+    for (int y = 0; y < level.correction.height; ++y) {
+        const float *diagonal = level.coefficients[plane(0, 0)].row(y);
+        const float *rhs = level.rhs.row(y);
+        const float *correction = level.correction.row(y);
+        for (int x = 0; x < level.correction.width; ++x) {
+            projection += (double) correction[x] * rhs[x];
+            energy += (double) correction[x] *
+                      (diagonal[x] * correction[x] - neighbourSum(level, level.correction, x, y));
+        }
+    }
+
+    double sums[2] = {projection, energy};
+    {
+        PhaseTimer timer(Phase::Reduction);
+        MPI_Allreduce(MPI_IN_PLACE, sums, 2, MPI_DOUBLE, MPI_SUM, level.decomposition.comm);
+    }
+
+    if (sums[0] <= 0 || sums[1] <= 0)
+        return 1.0f;
+    return (float) (sums[0] / sums[1]);
+}
+
+// Collects the owned cells of every rank into whole on rank 0, whole is only used there.
+static void gatherBlocks(const Decomposition &decomposition, const Grid &local, Grid *whole) {
+    std::vector<float> message((size_t) local.width * local.height);
+    for (int y = 0; y < local.height; ++y)
+        std::copy(local.row(y), local.row(y) + local.width, message.begin() + (size_t) y * local.width);
+
+    std::vector<int> counts(decomposition.size), displacements(decomposition.size);
+    std::vector<float> blocks;
+    if (decomposition.rank == 0) {
+        int offset = 0;
+        for (int rank = 0; rank < decomposition.size; ++rank) {
+            Block block = decomposition.blockOf(rank);
+            counts[rank] = block.width * block.height;
+            displacements[rank] = offset;
+            offset += counts[rank];
+        }
+        blocks.resize(offset);
+    }
+
+    MPI_Gatherv(message.data(), (int) message.size(), MPI_FLOAT, blocks.data(), counts.data(), displacements.data(),
+                MPI_FLOAT, 0, decomposition.comm);
+
+    if (decomposition.rank != 0)
+        return;
+
+    for (int rank = 0; rank < decomposition.size; ++rank) {
+        Block block = decomposition.blockOf(rank);
+        for (int y = 0; y < block.height; ++y) {
+            const float *in = &blocks[displacements[rank] + (size_t) y * block.width];
+            std::copy(in, in + block.width, whole->row(block.y0 + y) + block.x0);
+        }
+    }
+}
+
+// Inverse of gatherBlocks.
+static void scatterBlocks(const Decomposition &decomposition, const Grid *whole, Grid &local) {
+    std::vector<int> counts(decomposition.size), displacements(decomposition.size);
+    std::vector<float> blocks;
+    if (decomposition.rank == 0) {
+        int offset = 0;
+        for (int rank = 0; rank < decomposition.size; ++rank) {
+            Block block = decomposition.blockOf(rank);
+            counts[rank] = block.width * block.height;
+            displacements[rank] = offset;
+            offset += counts[rank];
+
+            for (int y = 0; y < block.height; ++y) {
+                const float *in = whole->row(block.y0 + y) + block.x0;
+                blocks.insert(blocks.end(), in, in + block.width);
+            }
+        }
+    }
+
+    std::vector<float> message((size_t) local.width * local.height);
+    MPI_Scatterv(blocks.data(), counts.data(), displacements.data(), MPI_FLOAT, message.data(), (int) message.size(),
+                 MPI_FLOAT, 0, decomposition.comm);
+
+    for (int y = 0; y < local.height; ++y)
+        std::copy(message.begin() + (size_t) y * local.width, message.begin() + (size_t) (y + 1) * local.width,
+                  local.row(y));
+}
+
+Multigrid::Multigrid(const StencilData &stencil, const Decomposition &decomposition, int width, int height) {
+    // Fine operator: count - 1 on the diagonal and a unit weight for every neighbour on the plate that is no spot.
+    auto fine = [&](int x, int y, int dy, int dx) -> float {
+        if (stencil.spotRow(y)[x])
+            return 0.0f;
+        if (dy == 0 && dx == 0)
+            return stencil.colWeight[x + stencil.halo] * stencil.rowWeight[y + stencil.halo] - 1.0f;
+
+        int globalX = stencil.x0 + x + dx;
+        int globalY = stencil.y0 + y + dy;
+        if (globalX < 0 || globalX >= decomposition.width || globalY < 0 || globalY >= decomposition.height)
+            return 0.0f;
+        return stencil.spotRow(y + dy)[x + dx] ? 0.0f : 1.0f;
+    };
+
+    levels.push_back(createLevel(coarsenDecomposition(decomposition)));
+    buildOperator(levels.back(), width, height, fine);
+
+    while (true) {
+        MultigridLevel &last = levels.back();
+        const Decomposition &current = last.decomposition;
+        bool coarsest = (long) current.width * current.height <= COARSEST_CELLS;
+
+        if (current.size > 1 && (coarsest || current.smallestBlockSide() < GATHER_BLOCK_SIDE)) {
+            last.gathered = true;
+
+            MultigridLevel whole;
+            if (current.rank == 0)
+                whole = createLevel(createDecomposition(MPI_COMM_SELF, current.width, current.height, 1, 1));
+            for (int i = 0; i < 9; ++i)
+                gatherBlocks(current, last.coefficients[i], current.rank == 0 ? &whole.coefficients[i] : nullptr);
+
+            if (current.rank != 0)
+                break;
+            levels.push_back(std::move(whole));
+            continue;
+        }
+
+        if (coarsest)
+            break;
+
+        MultigridLevel coarse = createLevel(coarsenDecomposition(current));
+        buildOperator(coarse, current.local.width, current.local.height, [&](int x, int y, int dy, int dx) {
+            return last.coefficients[plane(dy, dx)].row(y)[x];
+        });
+        levels.push_back(std::move(coarse));
+    }
+}
+
+Multigrid::~Multigrid() {
+    for (MultigridLevel &level: levels) {
+        level.halo.reset();
+        freeDecomposition(level.decomposition);
+    }
+}
+
+void Multigrid::cycle(size_t index) {
+    MultigridLevel &level = levels[index];
+    std::fill(level.correction.cells, level.correction.cells + level.correction.size(), 0.0f);
+
+    if (level.gathered) {
+        MultigridLevel *whole = index + 1 < levels.size() ? &levels[index + 1] : nullptr;
+        gatherBlocks(level.decomposition, level.rhs, whole ? &whole->rhs : nullptr);
+        if (whole)
+            cycle(index + 1);
+        scatterBlocks(level.decomposition, whole ? &whole->correction : nullptr, level.correction);
+        return;
+    }
+
+    if (index + 1 == levels.size()) {
+        smooth(level, COARSEST_SWEEPS);
+        return;
+    }
+
+    MultigridLevel &coarse = levels[index + 1];
+    const Grid &diagonal = level.coefficients[plane(0, 0)];
+    for (int visit = 0; visit < COARSE_VISITS; ++visit) {
+        smooth(level, COARSE_SWEEPS);
+        computeResidual(level);
+        restrictResidual(level.residual, coarse.rhs);
+
+        cycle(index + 1);
+
+        float scale = correctionScale(coarse);
+        prolongate(coarse.correction, scale, level.correction, [&](int x, int y) {
+            return diagonal.row(y)[x] != 0;
+        });
+    }
+    smooth(level, COARSE_SWEEPS);
+}
+
+void Multigrid::correct(const Grid &residual, Grid &current, const StencilData &stencil) {
+    MultigridLevel &coarse = levels.front();
+    restrictResidual(residual, coarse.rhs);
+
+    cycle(0);
+
+    float scale = correctionScale(coarse);
+    prolongate(coarse.correction, scale, current, [&](int x, int y) {
+        return !stencil.spotRow(y)[x];
+    });
+}
+
+float solveMultigrid(Grid &current, const StencilData &stencil, const Decomposition &decomposition,
+                     HaloExchange &halo, Checkpointer &checkpointer, SnapshotWriter &snapshots) {
+    Multigrid multigrid(stencil, decomposition, current.width, current.height);
+    Grid residual(current.width, current.height, 0, 0.0f);
+    long cycles = 0;
+
+    while (true) {
+        for (int sweep = 0; sweep < FINE_SWEEPS; ++sweep)
+            colourIteration(current, stencil, decomposition, halo, 1.0f);
+
+        halo.start(current);
+        halo.finish();
+
+        // The checkpoint and snapshot flags ride along with the diff.
+        float mine[3] = {stencilResidual(current, stencil, residual), checkpointer.due(), snapshots.due()};
+        float global[3];
+        {
+            PhaseTimer timer(Phase::Reduction);
+            MPI_Allreduce(mine, global, 3, MPI_FLOAT, MPI_MAX, decomposition.comm);
+        }
+        if (global[0] < CONVERGENCE_THRESHOLD)
+            return global[0];
+
+        cycles++;
+        if (global[1] > 0)
+            checkpointer.write(current, decomposition, cycles * FINE_SWEEPS, global[0]);
+        snapshots.offer(current, cycles * FINE_SWEEPS, global[2]);
+
+        multigrid.correct(residual, current, stencil);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef HW2_MULTIGRID_H
+#define HW2_MULTIGRID_H
+
+#include <memory>
+#include <vector>
+#include "Grid.h"
+#include "Decomposition.h"
+#include "Halo.h"
+#include "Solver.h"
+
+// The steady state solves A x = b: every free cell times the number of its neighbours minus the sum of the
+// neighbours is zero, the spots are Dirichlet values that move to b. A coarse level stores its operator as
+// A e = D e - W e over the owned cells.
+struct MultigridLevel {
+    Decomposition decomposition;
+
+    // Planes [(dy + 1) * 3 + dx + 1] of the owned cells: the centre is the diagonal D, zero for a cell without free
+    // fine cells, the others are the weights W of the free neighbours in direction (dy, dx).
+    std::vector<Grid> coefficients;
+
+    // Correction e with a ghost ring for the stencil, right-hand side and residual of the owned cells.
+    Grid correction;
+    Grid rhs;
+    Grid residual;
+
+    std::unique_ptr<HaloExchange> halo;
+
+    // The level is handed to its copy holding the whole plate on rank 0, the next level there.
+    bool gathered = false;
+};
+
+// Aggregation multigrid below the fine grid. Every level sums 2x2 cells of the level above within each block
+// (Galerkin coarse operator with piecewise constant prolongation), spots and cells whose aggregate is all spots stay
+// fixed. Levels whose blocks get small are gathered on rank 0, which continues alone down to a few cells.
+class Multigrid {
+private:
+    std::vector<MultigridLevel> levels;
+
+    void cycle(size_t level);
+
+public:
+    // Collective over decomposition.comm.
+    Multigrid(const StencilData &stencil, const Decomposition &decomposition, int width, int height);
+
+    Multigrid(const Multigrid &) = delete;
+
+    Multigrid &operator=(const Multigrid &) = delete;
+
+    ~Multigrid();
+
+    // Restricts the residual of the owned fine cells, runs a W-cycle on the coarse levels from a zero correction and
+    // adds the correction to the free cells of current, scaled to minimize the error in the energy norm.
+    void correct(const Grid &residual, Grid &current, const StencilData &stencil);
+};
+
+// Multigrid solver mode: Gauss-Seidel sweeps with the regular stencil as the smoother, each followed by a coarse grid
+// correction, until the largest change a Jacobi sweep would make drops below the threshold. Returns that change.
+float solveMultigrid(Grid &current, const StencilData &stencil, const Decomposition &decomposition,
+                     HaloExchange &halo, Checkpointer &checkpointer, SnapshotWriter &snapshots);
+
+#endif //HW2_MULTIGRID_H
@@ -0,0 +1,149 @@
+#include <stdexcept>
+#include <vector>
+#include "Options.h"
+
+// Tile side of --active-tiles without a value.
+const int DEFAULT_TILE_SIDE = 64;
+
+static int parsePositive(const std::string &name, const std::string &value) {
+    int number;
+    try {
+        number = std::stoi(value);
+    } catch (const std::exception &) {
+        throw std::runtime_error("Option --" + name + " expects a number, got '" + value + "'!\n");
+    }
+
+    if (number < 1)
+        throw std::runtime_error("Option --" + name + " must be positive!\n");
+
+    return number;
+}
+
+static float parseOmega(const std::string &value) {
+    float omega;
+    try {
+        omega = std::stof(value);
+    } catch (const std::exception &) {
+        throw std::runtime_error("Option --omega expects a number, got '" + value + "'!\n");
+    }
+
+    if (omega <= 0 || omega >= 2)
+        throw std::runtime_error("Option --omega must lie in (0, 2)!\n");
+
+    return omega;
+}
+
+static float parseRootShare(const std::string &value) {
+    float share;
+    try {
+        share = std::stof(value);
+    } catch (const std::exception &) {
+        throw std::runtime_error("Option --root-share expects a number, got '" + value + "'!\n");
+    }
+
+    if (share <= 0 || share > 1)
+        throw std::runtime_error("Option --root-share must lie in (0, 1]!\n");
+
+    return share;
+}
+
+static void parseProcessGrid(const std::string &value, int &rows, int &cols) {
+    auto separator = value.find('x');
+    if (separator == std::string::npos)
+        throw std::runtime_error("Option --process-grid expects RxC, got '" + value + "'!\n");
+
+    rows = parsePositive("process-grid", value.substr(0, separator));
+    cols = parsePositive("process-grid", value.substr(separator + 1));
+}
+
+Options parseOptions(int argc, char **argv) {
+    Options options;
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument(argv[i]);
+
+        if (argument.rfind("--", 0) != 0) {
+            positional.push_back(argument);
+            continue;
+        }
+
+        auto separator = argument.find('=');
+        std::string name = argument.substr(2, separator == std::string::npos ? std::string::npos : separator - 2);
+        std::string value = separator == std::string::npos ? "" : argument.substr(separator + 1);
+
+        if (name == "kernel")
+            options.kernel = parseKernelIsa(value);
+        else if (name == "check-every")
+            options.checkInterval = value == "auto" ? 0 : parsePositive(name, value);
+        else if (name == "decomposition" && (value == "blocks" || value == "strips"))
+            options.strips = value == "strips";
+        else if (name == "process-grid")
+            parseProcessGrid(value, options.processRows, options.processCols);
+        else if (name == "threads")
+            options.threads = parsePositive(name, value);
+        else if (name == "halo-depth")
+            options.haloDepth = parsePositive(name, value);
+        else if (name == "transport")
+            options.transport = parseTransport(value);
+        else if (name == "scheme")
+            options.scheme = parseScheme(value);
+        else if (name == "storage")
+            options.storage = parseStorage(value);
+        else if (name == "active-tiles")
+            options.tileSide = value == "off" ? 0 : value.empty() ? DEFAULT_TILE_SIDE : parsePositive(name, value);
+        else if (name == "omega")
+            options.omega = value == "auto" ? 0 : parseOmega(value);
+        else if (name == "root-share")
+            options.rootShare = parseRootShare(value);
+        else if (name == "format")
+            options.format = parseOutputFormat(value);
+        else if (name == "preconditioner")
+            options.preconditioner = parsePreconditioner(value);
+        else if (name == "checkpoint" && !value.empty())
+            options.checkpointPath = value;
+        else if (name == "checkpoint-every")
+            options.checkpointInterval = parsePositive(name, value);
+        else if (name == "restart" && !value.empty())
+            options.restartPath = value;
+        else if (name == "warm-start" && (value.empty() || value == "off"))
+            options.warmStart = value.empty();
+        else if (name == "snapshot" && !value.empty())
+            options.snapshotPath = value;
+        else if (name == "snapshot-every") {
+            options.snapshotSeconds = !value.empty() && value.back() == 's';
+            options.snapshotInterval = parsePositive(name, options.snapshotSeconds ? value.substr(0, value.size() - 1)
+                                                                                   : value);
+        }
+        else if (name == "snapshot-downsample")
+            options.snapshotStep = parsePositive(name, value);
+        else if (name == "ensemble" && !value.empty())
+            options.ensemblePath = value;
+        else if (name == "group-size")
+            options.groupSize = parsePositive(name, value);
+        else if (name == "profile") {
+            options.profile = true;
+            options.profilePath = value;
+        }
+        else
+            throw std::runtime_error("Unknown option '" + argument + "'!\n");
+    }
+
+    // The members of an ensemble bring their own paths, and files of a single run would be overwritten by each of them.
+    if (!options.ensemblePath.empty()) {
+        if (!positional.empty())
+            throw std::runtime_error("An ensemble takes no INPUT_PATH and OUTPUT_PATH!\n");
+        if (!options.checkpointPath.empty() || !options.restartPath.empty() || !options.snapshotPath.empty() ||
+            options.profile)
+            throw std::runtime_error("Ensembles do not support --checkpoint, --restart, --snapshot or --profile!\n");
+        return options;
+    }
+
+    if (positional.size() != 2)
+        throw std::runtime_error("Expected INPUT_PATH and OUTPUT_PATH!\n");
+
+    options.inputPath = positional[0];
+    options.outputPath = positional[1];
+
+    return options;
+}
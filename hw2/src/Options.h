@@ -0,0 +1,82 @@
+#ifndef HW2_OPTIONS_H
+#define HW2_OPTIONS_H
+
+#include <string>
+#include "Stencil.h"
+#include "Solver.h"
+#include "Output.h"
+#include "Halo.h"
+
+// Command line configuration of the solver.
+struct Options {
+    std::string inputPath;
+    std::string outputPath;
+
+    KernelIsa kernel = KernelIsa::Auto;
+
+    // Iterations between global convergence checks, 0 adapts it to the convergence rate.
+    int checkInterval = 0;
+
+    // Horizontal strips instead of 2D blocks, an explicit process grid overrides both.
+    bool strips = false;
+    int processRows = 0;
+    int processCols = 0;
+
+    // Work of the block of rank 0, which also reads the instance and writes the output, relative to the other blocks.
+    float rootShare = 1.0f;
+
+    // OpenMP threads per rank, 0 keeps the OpenMP default.
+    int threads = 0;
+
+    // Ghost layers exchanged at once, the halo is refreshed every haloDepth sweeps.
+    int haloDepth = 1;
+
+    // Ghost cells of neighbours sent as messages, copied from shared memory on the same node or put with RMA.
+    Transport transport = Transport::Messages;
+
+    Scheme scheme = Scheme::Jacobi;
+
+    Storage storage = Storage::Float;
+
+    // Side of the tiles that Jacobi skips while they and their neighbours are quiet, 0 sweeps every cell.
+    int tileSide = 0;
+
+    // SOR relaxation factor, 0 estimates it from the Gauss-Seidel convergence rate.
+    float omega = 0;
+
+    Preconditioner preconditioner = Preconditioner::Block;
+
+    OutputFormat format = OutputFormat::P2;
+
+    // Checkpoint written every checkpointInterval seconds of wall time, none without a path.
+    std::string checkpointPath;
+    int checkpointInterval = 600;
+
+    // Checkpoint or raw output the solve starts from instead of the uniform initial temperature.
+    std::string restartPath;
+
+    // Initial field interpolated from solves of coarsened plates instead of the uniform initial temperature.
+    bool warmStart = false;
+
+    // Frames of the field streamed every snapshotInterval iterations, or seconds of wall time with snapshotSeconds,
+    // holding every snapshotStep-th cell in both directions, none without a path.
+    std::string snapshotPath;
+    int snapshotInterval = 1000;
+    bool snapshotSeconds = false;
+    int snapshotStep = 1;
+
+    // List of instances solved side by side by groups of groupSize ranks instead of a single instance, 0 sizes the
+    // groups to the instances.
+    std::string ensemblePath;
+    int groupSize = 0;
+
+    // Prints the time of the phases and the update rate, with a path also writes them as JSON.
+    bool profile = false;
+    std::string profilePath;
+};
+
+// Parses "INPUT_PATH OUTPUT_PATH [--option=value ...]", or only the options with an ensemble, throws on unknown or
+// malformed options.
+Options parseOptions(int argc, char **argv);
+
+#endif //HW2_OPTIONS_H
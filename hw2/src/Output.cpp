@@ -0,0 +1,124 @@
+#include <mpi.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "Output.h"
+
+// Width of a P2 field: three digits and a separator.
+const int P2_FIELD = 4;
+
+OutputFormat parseOutputFormat(const std::string &name) {
+    if (name == "p2")
+        return OutputFormat::P2;
+    if (name == "p5")
+        return OutputFormat::P5;
+    if (name == "raw")
+        return OutputFormat::Raw;
+
+    throw std::runtime_error("Unknown output format '" + name + "'!\n");
+}
+
+const char *outputFormatName(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::P2:
+            return "p2";
+        case OutputFormat::P5:
+            return "p5";
+        case OutputFormat::Raw:
+            return "raw";
+    }
+    return "unknown";
+}
+
+static int pixelBytes(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::P2:
+            return P2_FIELD;
+        case OutputFormat::P5:
+            return 1;
+        case OutputFormat::Raw:
+            return (int) sizeof(float);
+    }
+    return 0;
+}
+
+static std::string header(OutputFormat format, int width, int height) {
+    if (format == OutputFormat::Raw)
+        return "";
+
+    std::string magic = format == OutputFormat::P2 ? "P2" : "P5";
+    return magic + "\n" + std::to_string(width) + "\n" + std::to_string(height) + "\n255\n";
+}
+
+static int grey(float temperature) {
+    return (int) std::max(std::min(temperature, 255.0f), 0.0f);
+}
+
+// Encodes the owned cells row by row. P2 fields are right-aligned, the last pixel of an image row ends the line.
+static std::vector<char> encodeBlock(OutputFormat format, const Grid &current, const Decomposition &decomposition) {
+    const Block &local = decomposition.local;
+    int bytes = pixelBytes(format);
+    std::vector<char> buffer((size_t) local.width * local.height * bytes);
+
+    char *out = buffer.data();
+    for (int y = 0; y < local.height; ++y) {
+        const float *row = current.row(y);
+        for (int x = 0; x < local.width; ++x, out += bytes) {
+            if (format == OutputFormat::Raw) {
+                std::memcpy(out, &row[x], sizeof(float));
+                continue;
+            }
+
+            int value = grey(row[x]);
+            if (format == OutputFormat::P5) {
+                *out = (char) value;
+                continue;
+            }
+
+            out[0] = value >= 100 ? (char) ('0' + value / 100) : ' ';
+            out[1] = value >= 10 ? (char) ('0' + value / 10 % 10) : ' ';
+            out[2] = (char) ('0' + value % 10);
+            out[3] = local.x0 + x == decomposition.width - 1 ? '\n' : ' ';
+        }
+    }
+
+    return buffer;
+}
+
+void writeOutput(const std::string &path, OutputFormat format, const Grid &current,
+                 const Decomposition &decomposition) {
+    const Block &local = decomposition.local;
+    std::string head = header(format, decomposition.width, decomposition.height);
+    std::vector<char> buffer = encodeBlock(format, current, decomposition);
+
+    MPI_File file;
+    if (MPI_File_open(decomposition.comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                      &file) != MPI_SUCCESS)
+        throw std::runtime_error("It is not possible to open output file!\n");
+
+    // Cuts off the rest of an older, longer file.
+    MPI_Offset bytes = pixelBytes(format);
+    MPI_File_set_size(file, (MPI_Offset) head.size() + bytes * decomposition.width * decomposition.height);
+
+    if (decomposition.rank == 0 && !head.empty())
+        MPI_File_write_at(file, 0, head.data(), (int) head.size(), MPI_CHAR, MPI_STATUS_IGNORE);
+
+    // Behind the header every rank sees only its block of the image.
+    MPI_Datatype pixel, region;
+    MPI_Type_contiguous((int) bytes, MPI_BYTE, &pixel);
+    MPI_Type_commit(&pixel);
+
+    int sizes[2] = {decomposition.height, decomposition.width};
+    int subsizes[2] = {local.height, local.width};
+    int starts[2] = {local.y0, local.x0};
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, pixel, &region);
+    MPI_Type_commit(&region);
+
+    MPI_File_set_view(file, (MPI_Offset) head.size(), pixel, region, "native", MPI_INFO_NULL);
+    MPI_File_write_all(file, buffer.data(), local.width * local.height, pixel, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+
+    MPI_Type_free(&region);
+    MPI_Type_free(&pixel);
+}
@@ -0,0 +1,27 @@
+#ifndef HW2_OUTPUT_H
+#define HW2_OUTPUT_H
+
+#include <string>
+#include "Grid.h"
+#include "Decomposition.h"
+
+// Format of the result image.
+//  - P2 is the ASCII Netpbm graymap, every pixel takes a fixed-width field so the ranks know where to write.
+//  - P5 is the binary Netpbm graymap, one byte per pixel.
+//  - Raw is the bare row-major float32 field in native byte order, without clamping or a header.
+enum class OutputFormat {
+    P2,
+    P5,
+    Raw
+};
+
+OutputFormat parseOutputFormat(const std::string &name);
+
+const char *outputFormatName(OutputFormat format);
+
+// Collective over decomposition.comm, every rank writes the owned cells of current to their place in the file with
+// MPI-IO. Nothing is gathered on the root. Throws when the file cannot be opened.
+void writeOutput(const std::string &path, OutputFormat format, const Grid &current,
+                 const Decomposition &decomposition);
+
+#endif //HW2_OUTPUT_H
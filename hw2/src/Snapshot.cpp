@@ -0,0 +1,140 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "Snapshot.h"
+#include "Options.h"
+#include "Instrumentation.h"
+
+const size_t MAGIC_BYTES = sizeof(SNAPSHOT_MAGIC) - 1;
+const size_t HEADER_BYTES = MAGIC_BYTES + 3 * sizeof(int32_t);
+
+// Index of the first sampled cell at or after position.
+static int firstSample(int position, int step) {
+    return (position + step - 1) / step;
+}
+
+SnapshotWriter::SnapshotWriter(const Options &options, const Decomposition &decomposition, long firstIteration)
+        : enabled(!options.snapshotPath.empty()), interval(options.snapshotInterval),
+          seconds(options.snapshotSeconds), step(options.snapshotStep), firstIteration(firstIteration),
+          rank(decomposition.rank), lastWrite(MPI_Wtime()),
+          nextIteration(options.snapshotInterval) {
+    if (!enabled)
+        return;
+
+    if (MPI_File_open(decomposition.comm, options.snapshotPath.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &file) != MPI_SUCCESS)
+        throw std::runtime_error("It is not possible to open snapshot file!\n");
+    MPI_File_set_size(file, 0);
+
+    int width = firstSample(decomposition.width, step);
+    int height = firstSample(decomposition.height, step);
+    if (rank == 0) {
+        char header[HEADER_BYTES];
+        int32_t size[3] = {width, height, step};
+        std::memcpy(header, SNAPSHOT_MAGIC, MAGIC_BYTES);
+        std::memcpy(header + MAGIC_BYTES, size, sizeof(size));
+        MPI_File_write_at(file, 0, header, (int) HEADER_BYTES, MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    const Block &local = decomposition.local;
+    originX = local.x0;
+    originY = local.y0;
+    fromX = firstSample(local.x0, step);
+    toX = firstSample(local.x0 + local.width, step);
+    fromY = firstSample(local.y0, step);
+    toY = firstSample(local.y0 + local.height, step);
+    bool hasCells = fromX < toX && fromY < toY;
+
+    // The view of a rank is the iteration (rank 0) and its rectangle of the frame, repeated once per frame.
+    MPI_Datatype types[2];
+    int lengths[2];
+    MPI_Aint displacements[2];
+    int count = 0;
+    if (rank == 0) {
+        types[count] = MPI_BYTE;
+        lengths[count] = (int) sizeof(int64_t);
+        displacements[count++] = 0;
+    }
+
+    MPI_Datatype region = MPI_DATATYPE_NULL;
+    if (hasCells) {
+        int sizes[2] = {height, width};
+        int subsizes[2] = {toY - fromY, toX - fromX};
+        int starts[2] = {fromY, fromX};
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_FLOAT, &region);
+        types[count] = region;
+        lengths[count] = 1;
+        displacements[count++] = sizeof(int64_t);
+    }
+
+    bytes = (rank == 0 ? (int) sizeof(int64_t) : 0) +
+            (hasCells ? (toX - fromX) * (toY - fromY) * (int) sizeof(float) : 0);
+    if (count == 0) {
+        MPI_File_set_view(file, (MPI_Offset) HEADER_BYTES, MPI_BYTE, MPI_BYTE, "native", MPI_INFO_NULL);
+        return;
+    }
+
+    MPI_Datatype record, frame;
+    MPI_Type_create_struct(count, lengths, displacements, types, &record);
+    MPI_Type_create_resized(record, 0, (MPI_Aint) (sizeof(int64_t) + sizeof(float) * (size_t) width * height),
+                            &frame);
+    MPI_Type_commit(&frame);
+    MPI_File_set_view(file, (MPI_Offset) HEADER_BYTES, MPI_BYTE, frame, "native", MPI_INFO_NULL);
+    MPI_Type_free(&frame);
+    MPI_Type_free(&record);
+    if (region != MPI_DATATYPE_NULL)
+        MPI_Type_free(&region);
+
+    buffers[0].resize(bytes);
+    buffers[1].resize(bytes);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (!enabled)
+        return;
+
+    MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    MPI_File_close(&file);
+}
+
+float SnapshotWriter::due() const {
+    return enabled && seconds && MPI_Wtime() - lastWrite >= interval ? (float) (frames + 1) : 0.0f;
+}
+
+void SnapshotWriter::offer(const Grid &current, long iteration, float requested) {
+    if (wants(iteration, requested))
+        write(current, iteration);
+}
+
+bool SnapshotWriter::wants(long iteration, float requested) const {
+    return enabled && (seconds ? requested > (float) frames : iteration >= nextIteration);
+}
+
+void SnapshotWriter::write(const Grid &current, long iteration) {
+    PhaseTimer timer(Phase::Snapshot);
+    lastWrite = MPI_Wtime();
+    nextIteration = (iteration / interval + 1) * interval;
+    long frame = frames++;
+    if (bytes == 0)
+        return;
+
+    // The buffer was handed out two frames ago.
+    MPI_Request &request = requests[frame % 2];
+    std::vector<char> &buffer = buffers[frame % 2];
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+
+    char *out = buffer.data();
+    if (rank == 0) {
+        int64_t total = firstIteration + iteration;
+        std::memcpy(out, &total, sizeof(total));
+        out += sizeof(total);
+    }
+
+    for (int y = fromY; y < toY; ++y) {
+        const float *row = current.row(y * step - originY);
+        for (int x = fromX; x < toX; ++x, out += sizeof(float))
+            std::memcpy(out, &row[x * step - originX], sizeof(float));
+    }
+
+    MPI_File_iwrite_at(file, (MPI_Offset) frame * bytes, buffer.data(), bytes, MPI_BYTE, &request);
+}
@@ -0,0 +1,76 @@
+#ifndef HW2_SNAPSHOT_H
+#define HW2_SNAPSHOT_H
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+#include "Grid.h"
+#include "Decomposition.h"
+
+struct Options;
+
+// First bytes of a snapshot file: the magic, int32 frame width and height and int32 step, followed by the frames, each
+// an int64 iteration and the row-major float32 frame, all in native byte order. A frame holds every step-th cell of
+// every step-th row of the plate, starting with cell [0, 0]. The number of frames follows from the file size.
+#define SNAPSHOT_MAGIC "HDS1"
+
+// Streams snapshots of the field to options.snapshotPath every snapshotInterval iterations or seconds of wall time.
+//
+// Every rank copies its cells of a frame into one of two buffers and hands it to MPI_File_iwrite_at, so the sweeps go
+// on while the frame is written. A buffer is only reused once the write of the frame before the last one completed,
+// so the solve waits for the disk only when it produces frames faster than they are written.
+class SnapshotWriter {
+private:
+    bool enabled;
+    int interval;
+    bool seconds;
+    int step;
+    long firstIteration;
+    int rank;
+    double lastWrite;
+
+    MPI_File file = MPI_FILE_NULL;
+    // Frame cells of this rank, [fromX, toX) x [fromY, toY) of the frame, and the plate position of its block.
+    int fromX = 0;
+    int toX = 0;
+    int fromY = 0;
+    int toY = 0;
+    int originX = 0;
+    int originY = 0;
+    // Bytes this rank adds to a frame, the iteration of rank 0 included.
+    int bytes = 0;
+    long frames = 0;
+    long nextIteration;
+
+    std::vector<char> buffers[2];
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+
+public:
+    // Collective over decomposition.comm, creates the file and writes its header. firstIteration is the iteration the
+    // solve restarted from, the frames count on from it. Throws when the file cannot be opened.
+    SnapshotWriter(const Options &options, const Decomposition &decomposition, long firstIteration);
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    // Collective over decomposition.comm, waits for the frames in flight and closes the file.
+    ~SnapshotWriter();
+
+    // Number of the next frame once the interval of wall time elapsed on this rank, 0 otherwise or with snapshots every
+    // few iterations. The ranks agree on a snapshot through a MAX reduction of the flags (see ConvergenceMonitor), a
+    // flag posted before the frame was written names a frame that exists by the time it arrives and is ignored.
+    float due() const;
+
+    // Called by all ranks after every sweep or cycle with the flag agreed on for it, writes a frame of current when one
+    // is due. A scheme that advances several iterations at once gets a frame once it passed a multiple of the interval.
+    void offer(const Grid &current, long iteration, float requested);
+
+    // True when offer() would write a frame.
+    bool wants(long iteration, float requested) const;
+
+    // Writes a frame of current, every rank at the same iteration.
+    void write(const Grid &current, long iteration);
+};
+
+#endif //HW2_SNAPSHOT_H
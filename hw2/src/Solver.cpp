@@ -0,0 +1,630 @@
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include "Solver.h"
+#include "Options.h"
+#include "Halo.h"
+#include "Convergence.h"
+#include "Multigrid.h"
+#include "ConjugateGradient.h"
+#include "Checkpoint.h"
+#include "Snapshot.h"
+#include "ActiveTiles.h"
+#include "Instrumentation.h"
+
+Scheme parseScheme(const std::string &name) {
+    if (name == "jacobi")
+        return Scheme::Jacobi;
+    if (name == "gs")
+        return Scheme::GaussSeidel;
+    if (name == "sor")
+        return Scheme::Sor;
+    if (name == "mg")
+        return Scheme::Multigrid;
+    if (name == "cg")
+        return Scheme::ConjugateGradient;
+
+    throw std::runtime_error("Unknown scheme '" + name + "'!\n");
+}
+
+const char *schemeName(Scheme scheme) {
+    switch (scheme) {
+        case Scheme::Jacobi:
+            return "jacobi";
+        case Scheme::GaussSeidel:
+            return "gs";
+        case Scheme::Sor:
+            return "sor";
+        case Scheme::Multigrid:
+            return "mg";
+        case Scheme::ConjugateGradient:
+            return "cg";
+    }
+    return "unknown";
+}
+
+Preconditioner parsePreconditioner(const std::string &name) {
+    if (name == "jacobi")
+        return Preconditioner::Jacobi;
+    if (name == "block")
+        return Preconditioner::Block;
+
+    throw std::runtime_error("Unknown preconditioner '" + name + "'!\n");
+}
+
+const char *preconditionerName(Preconditioner preconditioner) {
+    switch (preconditioner) {
+        case Preconditioner::Jacobi:
+            return "jacobi";
+        case Preconditioner::Block:
+            return "block";
+    }
+    return "unknown";
+}
+
+Storage parseStorage(const std::string &name) {
+    if (name == "float")
+        return Storage::Float;
+    if (name == "compact")
+        return Storage::Compact;
+
+    throw std::runtime_error("Unknown storage '" + name + "'!\n");
+}
+
+const char *storageName(Storage storage) {
+    switch (storage) {
+        case Storage::Float:
+            return "float";
+        case Storage::Compact:
+            return "compact";
+    }
+    return "unknown";
+}
+
+std::vector<float> axisWeights(const int &from, const int &count, const int &length) {
+    std::vector<float> weights(count);
+    for (int i = 0; i < count; ++i)
+        weights[i] = 1.0f + (from + i > 0) + (from + i < length - 1);
+    return weights;
+}
+
+// Applies the stencil to the rectangle [fromY, toY) x [fromX, toX) of the block and returns its max diff.
+// Inside a parallel region the rows are shared among the threads and each thread returns the max of its rows.
+static float sweepBlock(const Grid &current, Grid &next, const StencilData &stencil,
+                        const int &fromY, const int &toY, const int &fromX, const int &toX) {
+    float diff = 0;
+    if (fromX >= toX)
+        return diff;
+
+#pragma omp for schedule(static) nowait
+    for (int y = fromY; y < toY; ++y) {
+        diff = std::max(stencil.kernel(current.row(y - 1) + fromX,
+                                       current.row(y) + fromX,
+                                       current.row(y + 1) + fromX,
+                                       next.row(y) + fromX,
+                                       stencil.spotRow(y) + fromX,
+                                       &stencil.colWeight[fromX + stencil.halo],
+                                       stencil.rowWeight[y + stencil.halo],
+                                       toX - fromX), diff);
+    }
+
+    return diff;
+}
+
+// sweepBlock on compact grids. The rows are widened to float for columns [fromX - 1, toX + 1), the kernel averages
+// them into a float line and that is narrowed into next, so the diff is the change before the rounding to the code.
+// The rows of a thread are consecutive, each widened row serves the three rows around it.
+static float sweepCompact(const CompactGrid &current, CompactGrid &next, const StencilData &stencil,
+                          const FixedPoint &code, const int &fromY, const int &toY, const int &fromX, const int &toX) {
+    float diff = 0;
+    if (fromX >= toX)
+        return diff;
+
+    static thread_local std::vector<float> lines[3];
+    static thread_local std::vector<float> out;
+    int lineRow[3] = {fromY - 2, fromY - 2, fromY - 2};
+    for (auto &line: lines)
+        line.resize(toX - fromX + 2);
+    out.resize(toX - fromX);
+
+    auto widened = [&](int y) {
+        int slot = ((y % 3) + 3) % 3;
+        if (lineRow[slot] != y) {
+            const uint16_t *source = current.row(y) + fromX - 1;
+            float *line = lines[slot].data();
+            for (int x = 0; x < toX - fromX + 2; ++x)
+                line[x] = code.widen(source[x]);
+            lineRow[slot] = y;
+        }
+        return lines[slot].data() + 1;
+    };
+
+#pragma omp for schedule(static) nowait
+    for (int y = fromY; y < toY; ++y) {
+        const float *above = widened(y - 1);
+        const float *row = widened(y);
+        const float *below = widened(y + 1);
+        diff = std::max(stencil.kernel(above, row, below, out.data(),
+                                       stencil.spotRow(y) + fromX,
+                                       &stencil.colWeight[fromX + stencil.halo],
+                                       stencil.rowWeight[y + stencil.halo],
+                                       toX - fromX), diff);
+
+        uint16_t *target = next.row(y) + fromX;
+        const float *line = out.data();
+        for (int x = 0; x < toX - fromX; ++x)
+            target[x] = code.narrow(line[x]);
+    }
+
+    return diff;
+}
+
+// Updates the cells of one colour of the rectangle in place. The vector kernel averages the whole row into a scratch
+// line, which is safe because the cells of one colour only read cells of the other colours.
+//
+// The cell moves omega times the Gauss-Seidel correction of the linear system (count - 1) x = sum of the neighbours,
+// which is count / (count - 1) times the correction of the average (the cell itself included). omega = 1 is the true
+// Gauss-Seidel step that Young's formula is about.
+static float sweepColour(Grid &grid, const StencilData &stencil, const int &colour, const float &omega,
+                         const int &fromY, const int &toY, const int &fromX, const int &toX) {
+    float diff = 0;
+    if (fromX >= toX)
+        return diff;
+
+    static thread_local std::vector<float> average;
+    average.resize(toX - fromX);
+
+    int firstX = fromX + (((stencil.x0 + fromX) & 1) != (colour & 1));
+
+#pragma omp for schedule(static) nowait
+    for (int y = fromY; y < toY; ++y) {
+        if (((stencil.y0 + y) & 1) != (colour >> 1))
+            continue;
+
+        float *row = grid.row(y);
+        stencil.kernel(grid.row(y - 1) + fromX,
+                       row + fromX,
+                       grid.row(y + 1) + fromX,
+                       average.data(),
+                       stencil.spotRow(y) + fromX,
+                       &stencil.colWeight[fromX + stencil.halo],
+                       stencil.rowWeight[y + stencil.halo],
+                       toX - fromX);
+
+        // Spots come back from the kernel unchanged, so the relaxation keeps them as well.
+        float rowWeight = stencil.rowWeight[y + stencil.halo];
+        for (int x = firstX; x < toX; x += 2) {
+            float old = row[x];
+            float value = average[x - fromX];
+            float count = stencil.colWeight[x + stencil.halo] * rowWeight;
+            if (count > 1)
+                value = old + omega * count / (count - 1) * (value - old);
+
+            row[x] = value;
+            diff = std::max(std::abs(old - value), diff);
+        }
+    }
+
+    return diff;
+}
+
+// Runs sweep(fromY, toY, fromX, toX) over the owned cells and returns their max diff. With exchange the halo is
+// refreshed meanwhile: MPI is funneled through the master thread, and all threads first compute the cells that do not
+// need the ghost cells. Cells on the plate border never wait. The grow outermost ghost layers on the sides with a
+// neighbour are recomputed as well, their diff belongs to the neighbour.
+template<typename Cells, typename Sweep>
+static float overlapHalo(Cells &grid, const Decomposition &decomposition, HaloExchange &halo, const bool &exchange,
+                         const int &grow, const Sweep &sweep) {
+    int width = grid.width;
+    int height = grid.height;
+    bool hasTop = decomposition.neighbours[0][1] != MPI_PROC_NULL;
+    bool hasBottom = decomposition.neighbours[2][1] != MPI_PROC_NULL;
+    bool hasLeft = decomposition.neighbours[1][0] != MPI_PROC_NULL;
+    bool hasRight = decomposition.neighbours[1][2] != MPI_PROC_NULL;
+
+    int top = std::min(exchange && hasTop ? 1 : 0, height);
+    int bottom = std::min(exchange && hasBottom ? 1 : 0, height - top);
+    int left = std::min(exchange && hasLeft ? 1 : 0, width);
+    int right = std::min(exchange && hasRight ? 1 : 0, width - left);
+
+    int growTop = hasTop ? grow : 0;
+    int growBottom = hasBottom ? grow : 0;
+    int growLeft = hasLeft ? grow : 0;
+    int growRight = hasRight ? grow : 0;
+
+    float diff = 0;
+
+#pragma omp parallel reduction(max:diff)
+    {
+        if (exchange) {
+#pragma omp master
+            halo.start(grid);
+        }
+
+        diff = std::max(sweep(top, height - bottom, left, width - right), diff);
+
+        if (exchange) {
+#pragma omp master
+            halo.finish();
+#pragma omp barrier
+        }
+
+        diff = std::max(sweep(0, top, 0, width), diff);
+        diff = std::max(sweep(height - bottom, height, 0, width), diff);
+        diff = std::max(sweep(top, height - bottom, 0, left), diff);
+        diff = std::max(sweep(top, height - bottom, width - right, width), diff);
+
+        if (grow > 0) {
+            sweep(-growTop, 0, -growLeft, width + growRight);
+            sweep(height, height + growBottom, -growLeft, width + growRight);
+            sweep(0, height, -growLeft, 0);
+            sweep(0, height, width, width + growRight);
+        }
+    }
+
+    return diff;
+}
+
+// One Jacobi sweep. With a halo of depth k the ghost cells are exchanged only in phase 0, and every phase also
+// recomputes the ghost cells that the remaining k - 1 - phase sweeps read, so the neighbours' values stay exact
+// without communication. The redundant cells do the same arithmetic as their owner.
+static float jacobiIteration(Grid &current, Grid &next, const StencilData &stencil,
+                             const Decomposition &decomposition, HaloExchange &halo, const int &phase) {
+    return overlapHalo(current, decomposition, halo, phase == 0, current.halo - 1 - phase,
+                       [&](int fromY, int toY, int fromX, int toX) {
+                           return sweepBlock(current, next, stencil, fromY, toY, fromX, toX);
+                       });
+}
+
+// Applies the stencil to the given bands of tiles, each band by one thread row by row. A measuring sweep records the
+// max diff of every tile, the others sweep each run of consecutive tiles at once.
+static float sweepTiles(const Grid &current, Grid &next, const StencilData &stencil, ActiveTiles &tiles,
+                        const std::vector<std::vector<int>> &bands) {
+    float diff = 0;
+    bool measuring = tiles.measuring();
+
+#pragma omp for schedule(dynamic) nowait
+    for (size_t band = 0; band < bands.size(); ++band) {
+        const std::vector<int> &list = bands[band];
+
+        // Row segments [from, to) and the tile each diff belongs to, consecutive tiles merge outside a measuring sweep.
+        std::vector<int> segmentFrom, segmentTo, owner;
+        int fromY, toY, fromX, toX;
+        for (size_t i = 0; i < list.size(); ++i) {
+            tiles.bounds(list[i], fromY, toY, fromX, toX);
+            if (!measuring && i > 0 && list[i] == list[i - 1] + 1) {
+                segmentTo.back() = toX;
+                continue;
+            }
+            segmentFrom.push_back(fromX);
+            segmentTo.push_back(toX);
+            owner.push_back(list[i]);
+        }
+
+        std::vector<float> segmentDiff(owner.size(), 0.0f);
+        for (int y = fromY; y < toY; ++y) {
+            for (size_t i = 0; i < owner.size(); ++i) {
+                int from = segmentFrom[i];
+                segmentDiff[i] = std::max(stencil.kernel(current.row(y - 1) + from,
+                                                         current.row(y) + from,
+                                                         current.row(y + 1) + from,
+                                                         next.row(y) + from,
+                                                         stencil.spotRow(y) + from,
+                                                         &stencil.colWeight[from + stencil.halo],
+                                                         stencil.rowWeight[y + stencil.halo],
+                                                         segmentTo[i] - from), segmentDiff[i]);
+            }
+        }
+
+        for (size_t i = 0; i < owner.size(); ++i) {
+            if (measuring)
+                tiles.record(owner[i], segmentDiff[i]);
+            diff = std::max(segmentDiff[i], diff);
+        }
+    }
+
+    return diff;
+}
+
+// One Jacobi sweep over the active tiles. The interior tiles overlap the halo exchange, the tiles on the sides shared
+// with a neighbour rank wait for it. Skipped tiles count as unchanged.
+static float activeJacobiIteration(Grid &current, Grid &next, const StencilData &stencil, HaloExchange &halo,
+                                   ActiveTiles &tiles) {
+    float diff = 0;
+
+#pragma omp parallel reduction(max:diff)
+    {
+#pragma omp master
+        halo.start(current);
+
+        diff = std::max(sweepTiles(current, next, stencil, tiles, tiles.interiorBands()), diff);
+
+#pragma omp master
+        halo.finish();
+#pragma omp barrier
+
+        diff = std::max(sweepTiles(current, next, stencil, tiles, tiles.borderBands()), diff);
+    }
+
+    tiles.update(current, next);
+    return diff;
+}
+
+// Steps of the compact code the diff falls to before the sweeps switch to float.
+const float COMPACT_SWITCH_CODES = 8.0f;
+
+// Jacobi sweeps on a compact copy of current until the global diff falls to COMPACT_SWITCH_CODES steps of the code,
+// where the rounding would soon stall the sweeps, then current holds the field again with the exact spots. The float
+// cells of current are freed meanwhile unless a halo transport holds them in a window. Checkpoints and snapshots get
+// the widened field. Returns the number of sweeps.
+static long compactJacobi(Grid &current, const StencilData &stencil, const Decomposition &decomposition,
+                          HaloExchange &halo, const Options &options, Checkpointer &checkpointer,
+                          SnapshotWriter &snapshots) {
+    // Jacobi averages never leave the range of the field.
+    float range[2] = {0, 0};
+    for (int y = 0; y < current.height; ++y) {
+        for (int x = 0; x < current.width; ++x) {
+            range[0] = std::min(current.row(y)[x], range[0]);
+            range[1] = std::min(-current.row(y)[x], range[1]);
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, range, 2, MPI_FLOAT, MPI_MIN, decomposition.comm);
+    FixedPoint code(range[0], -range[1]);
+
+    CompactGrid compact(current, code);
+    CompactGrid next = compact;
+
+    std::vector<std::pair<size_t, float>> spots;
+    for (size_t i = 0; i < current.size(); ++i) {
+        if (stencil.isSpot[i])
+            spots.emplace_back(i, current.cells[i]);
+    }
+
+    bool freed = options.transport == Transport::Messages && current.cells == current.data.data();
+    if (freed) {
+        std::vector<float>().swap(current.data);
+        current.cells = nullptr;
+    }
+
+    Grid widened;
+    auto widen = [&]() -> Grid & {
+        Grid &target = freed ? widened : current;
+        if (freed && target.size() == 0)
+            target = Grid(current.width, current.height, current.halo, 0.0f);
+        compact.widen(target, code);
+        for (auto &spot: spots)
+            target.cells[spot.first] = spot.second;
+        return target;
+    };
+
+    ConvergenceMonitor convergence(decomposition.comm, std::max(COMPACT_SWITCH_CODES * code.scale,
+                                                                CONVERGENCE_THRESHOLD), options.checkInterval);
+    long iteration = 0;
+    bool switched;
+    do {
+        int phase = (int) (iteration % current.halo);
+        float myDiff = overlapHalo(compact, decomposition, halo, phase == 0, current.halo - 1 - phase,
+                                   [&](int fromY, int toY, int fromX, int toX) {
+                                       return sweepCompact(compact, next, stencil, code, fromY, toY, fromX, toX);
+                                   });
+        std::swap(compact, next);
+        iteration++;
+        recordSweep((long) current.width * current.height);
+
+        switched = convergence.update(iteration, myDiff, checkpointer.due(), snapshots.due());
+        if (!switched && convergence.checkpointDue())
+            checkpointer.write(widen(), decomposition, iteration, convergence.diff());
+        if (!switched && snapshots.wants(iteration, convergence.snapshotDue()))
+            snapshots.write(widen(), iteration);
+    } while (!switched);
+
+    widened = Grid();
+    next = CompactGrid();
+    if (freed) {
+        current.data.assign(current.size(), 0.0f);
+        current.cells = current.data.data();
+    }
+    compact.widen(current, code);
+    for (auto &spot: spots)
+        current.cells[spot.first] = spot.second;
+
+    return iteration;
+}
+
+float stencilResidual(const Grid &current, const StencilData &stencil, Grid &residual) {
+    float diff = 0;
+
+#pragma omp parallel for schedule(static) reduction(max:diff)
+    for (int y = 0; y < current.height; ++y) {
+        const float *above = current.row(y - 1);
+        const float *row = current.row(y);
+        const float *below = current.row(y + 1);
+        const uint8_t *fixed = stencil.spotRow(y);
+        float rowWeight = stencil.rowWeight[y + stencil.halo];
+        float *out = residual.row(y);
+
+        for (int x = 0; x < current.width; ++x) {
+            if (fixed[x]) {
+                out[x] = 0;
+                continue;
+            }
+
+            float count = stencil.colWeight[x + stencil.halo] * rowWeight;
+            float sum = row[x - 1] + row[x + 1] +
+                        above[x] + above[x + 1] + above[x - 1] +
+                        below[x] + below[x + 1] + below[x - 1];
+            out[x] = sum - (count - 1) * row[x];
+            diff = std::max(std::abs(out[x]) / count, diff);
+        }
+    }
+
+    return diff;
+}
+
+float colourIteration(Grid &grid, const StencilData &stencil, const Decomposition &decomposition, HaloExchange &halo,
+                      const float &omega) {
+    recordSweep((long) grid.width * grid.height);
+    float diff = 0;
+    for (int colour = 0; colour < 4; ++colour) {
+        diff = std::max(overlapHalo(grid, decomposition, halo, true, 0,
+                                    [&](int fromY, int toY, int fromX, int toX) {
+                                        return sweepColour(grid, stencil, colour, omega, fromY, toY, fromX, toX);
+                                    }), diff);
+    }
+    return diff;
+}
+
+// Estimates the optimal SOR factor with Young's formula omega = 2 / (1 + sqrt(1 - rho)), where rho is the asymptotic
+// convergence rate of Gauss-Seidel measured on the first sweeps. The sweeps are real Gauss-Seidel sweeps and are
+// counted in iteration. Every rank sees the same global diffs, so every rank gets the same omega.
+static float estimateOmega(Grid &grid, const StencilData &stencil, const Decomposition &decomposition,
+                           HaloExchange &halo, long &iteration) {
+    const int window = 10;
+    const int maxSweeps = 1000;
+
+    double lastDiff = -1;
+    double rate = -1;
+    for (int sweep = 1; sweep <= maxSweeps; ++sweep) {
+        float diff = colourIteration(grid, stencil, decomposition, halo, 1.0f);
+        iteration++;
+
+        if (sweep % window != 0)
+            continue;
+
+        float globalDiff;
+        {
+            PhaseTimer timer(Phase::Reduction);
+            MPI_Allreduce(&diff, &globalDiff, 1, MPI_FLOAT, MPI_MAX, decomposition.comm);
+        }
+        if (globalDiff < CONVERGENCE_THRESHOLD || globalDiff == 0)
+            return 1.0f;
+
+        if (lastDiff > 0) {
+            double windowRate = std::pow(globalDiff / lastDiff, 1.0 / window);
+            // A field restored from an over-relaxed solve first grows under Gauss-Seidel, so only a decay counts.
+            bool settled = rate > 0 && windowRate < 1 && std::abs(windowRate - rate) < 1e-4;
+            rate = windowRate;
+            if (settled)
+                break;
+        }
+        lastDiff = globalDiff;
+    }
+
+    if (rate <= 0 || rate >= 1)
+        return 1.0f;
+
+    return (float) std::min(2.0 / (1.0 + std::sqrt(1.0 - rate)), 1.99);
+}
+
+// Change under which a tile counts as quiet, relative to the convergence threshold.
+const float ACTIVE_TILE_FRACTION = 0.1f;
+
+// Global diff under which SOR hands over to plain Gauss-Seidel sweeps.
+const float SOR_FINISH_FACTOR = 10.0f;
+
+float simulate(Grid &current, const StencilData &stencil, const Decomposition &decomposition, const Options &options,
+               long restartIteration) {
+    HaloExchange halo(decomposition, current, options.transport);
+    halo.share(current);
+    Checkpointer checkpointer(options, restartIteration);
+    SnapshotWriter snapshots(options, decomposition, restartIteration);
+    long iteration = 0;
+
+    if (options.storage == Storage::Compact && options.scheme != Scheme::Jacobi)
+        throw std::runtime_error("Only the Jacobi scheme stores the grid compactly!\n");
+    if (options.storage == Storage::Compact && options.tileSide > 0)
+        throw std::runtime_error("Active tiles need --storage=float!\n");
+
+    if (options.scheme == Scheme::Jacobi) {
+        if (options.storage == Storage::Compact)
+            iteration = compactJacobi(current, stencil, decomposition, halo, options, checkpointer, snapshots);
+
+        // Double buffer, spots are already in place in both grids.
+        Grid next = current;
+        ConvergenceMonitor convergence(decomposition.comm, CONVERGENCE_THRESHOLD, options.checkInterval);
+
+        std::unique_ptr<ActiveTiles> tiles;
+        if (options.tileSide > 0) {
+            if (current.halo != 1)
+                throw std::runtime_error("Active tiles need --halo-depth=1!\n");
+            tiles = std::make_unique<ActiveTiles>(options.tileSide, ACTIVE_TILE_FRACTION * CONVERGENCE_THRESHOLD,
+                                                  decomposition, current.width, current.height);
+        }
+        halo.share(next);
+
+        float finalDiff;
+        bool converged;
+        do {
+            int phase = (int) (iteration % current.halo);
+            float myDiff = tiles ? activeJacobiIteration(current, next, stencil, halo, *tiles)
+                                 : jacobiIteration(current, next, stencil, decomposition, halo, phase);
+            std::swap(current, next);
+            iteration++;
+            recordSweep((long) current.width * current.height);
+
+            converged = convergence.update(iteration, myDiff, checkpointer.due(), snapshots.due());
+            finalDiff = convergence.diff();
+            if (!converged && convergence.checkpointDue())
+                checkpointer.write(current, decomposition, iteration, convergence.diff());
+            if (!converged)
+                snapshots.offer(current, iteration, convergence.snapshotDue());
+
+            // The skipped tiles drift by less than the tolerance per sweep, but that adds up, so a stop is confirmed
+            // by a sweep over all tiles. Every rank confirms, even one without skipped tiles.
+            if (converged && tiles) {
+                tiles->activateAll();
+                myDiff = activeJacobiIteration(current, next, stencil, halo, *tiles);
+                std::swap(current, next);
+                iteration++;
+                recordSweep((long) current.width * current.height);
+
+                PhaseTimer timer(Phase::Reduction);
+                MPI_Allreduce(&myDiff, &finalDiff, 1, MPI_FLOAT, MPI_MAX, decomposition.comm);
+                converged = finalDiff < CONVERGENCE_THRESHOLD;
+            }
+        } while (!converged);
+
+        halo.release(next);
+        return finalDiff;
+    }
+
+    if (current.halo != 1)
+        throw std::runtime_error("Only the Jacobi scheme uses deep halos, use --halo-depth=1!\n");
+    if (options.tileSide > 0)
+        throw std::runtime_error("Only the Jacobi scheme tracks active tiles!\n");
+
+    if (options.scheme == Scheme::Multigrid)
+        return solveMultigrid(current, stencil, decomposition, halo, checkpointer, snapshots);
+    if (options.scheme == Scheme::ConjugateGradient)
+        return solveConjugateGradient(current, stencil, decomposition, halo, options, checkpointer,
+                                      snapshots);
+
+    float omega = 1.0f;
+    if (options.scheme == Scheme::Sor)
+        omega = options.omega > 0 ? options.omega : estimateOmega(current, stencil, decomposition, halo, iteration);
+
+    // The max diff of an over-relaxed sweep may grow again, so the monitor confirms the stop with the last sweep.
+    ConvergenceMonitor convergence(decomposition.comm, CONVERGENCE_THRESHOLD, options.checkInterval, 64,
+                                   options.scheme != Scheme::Sor);
+
+    bool converged;
+    do {
+        float myDiff = colourIteration(current, stencil, decomposition, halo, omega);
+        iteration++;
+
+        converged = convergence.update(iteration, myDiff, checkpointer.due(), snapshots.due());
+        if (!converged && convergence.checkpointDue())
+            checkpointer.write(current, decomposition, iteration, convergence.diff());
+        if (!converged)
+            snapshots.offer(current, iteration, convergence.snapshotDue());
+
+        // Over-relaxation amplifies the rounding noise of the average above the threshold, so plain Gauss-Seidel
+        // sweeps settle the last digits once the field is close.
+        if (omega > 1 && convergence.diffIteration() > 0 &&
+            convergence.diff() < SOR_FINISH_FACTOR * CONVERGENCE_THRESHOLD)
+            omega = 1.0f;
+    } while (!converged);
+
+    return convergence.diff();
+}
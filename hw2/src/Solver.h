@@ -0,0 +1,102 @@
+#ifndef HW2_SOLVER_H
+#define HW2_SOLVER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Grid.h"
+#include "Stencil.h"
+#include "Decomposition.h"
+
+#define CONVERGENCE_THRESHOLD 0.0001f
+
+struct Options;
+
+class HaloExchange;
+
+class Checkpointer;
+
+class SnapshotWriter;
+
+// Update scheme of the stationary iteration.
+//  - Jacobi computes the whole sweep from the previous one (double buffer).
+//  - GaussSeidel updates the four colours of the 2x2 pattern one after another in place. The 9-point stencil never
+//    couples two cells of the same colour (red-black is not enough for the diagonals), so every colour is updated
+//    consistently and the result does not depend on the decomposition. The halo is exchanged once per colour.
+//  - Sor is the four-colour Gauss-Seidel sweep over-relaxed by omega.
+//  - Multigrid corrects Gauss-Seidel sweeps with cycles on coarser grids (see Multigrid.h).
+//  - ConjugateGradient solves the symmetric linear system of the steady state (see ConjugateGradient.h).
+enum class Scheme {
+    Jacobi,
+    GaussSeidel,
+    Sor,
+    Multigrid,
+    ConjugateGradient
+};
+
+Scheme parseScheme(const std::string &name);
+
+const char *schemeName(Scheme scheme);
+
+// Preconditioner of the conjugate gradient scheme.
+//  - Jacobi divides by the diagonal, count - 1.
+//  - Block applies a symmetric Gauss-Seidel sweep to bands of rows of the owned block, ignoring the cells outside the
+//    band, so it needs no communication and does not depend on the number of threads.
+enum class Preconditioner {
+    Jacobi,
+    Block
+};
+
+Preconditioner parsePreconditioner(const std::string &name);
+
+const char *preconditionerName(Preconditioner preconditioner);
+
+// Storage of the temperatures of the Jacobi scheme.
+//  - Float keeps them in float32 throughout.
+//  - Compact starts in the 16-bit fixed-point code of Compact.h, which halves the memory traffic of a sweep, and
+//    switches to float32 once the diff approaches the resolution of the code, so the result is as accurate.
+enum class Storage {
+    Float,
+    Compact
+};
+
+Storage parseStorage(const std::string &name);
+
+const char *storageName(Storage storage);
+
+// Spot mask, stencil weights and kernel of the local block, shared by all sweeps. The mask and the weights cover the
+// ghost cells as well, so the ghost cells can be recomputed redundantly.
+struct StencilData {
+    int x0;
+    int y0;
+    int halo;
+    int stride;
+    std::vector<uint8_t> isSpot;
+    std::vector<float> colWeight;
+    std::vector<float> rowWeight;
+    StencilRowKernel kernel;
+
+    const uint8_t *spotRow(int y) const {
+        return &isSpot[(size_t) (y + halo) * stride + halo];
+    }
+};
+
+// Number of cells the stencil averages along one axis, 2 on the border of the plate and 3 inside.
+std::vector<float> axisWeights(const int &from, const int &count, const int &length);
+
+// One four-colour Gauss-Seidel sweep over the owned cells relaxed by omega, 1 is plain Gauss-Seidel. The halo is
+// refreshed before every colour, the ghost cells are stale afterwards. Returns the local max diff.
+float colourIteration(Grid &grid, const StencilData &stencil, const Decomposition &decomposition, HaloExchange &halo,
+                      const float &omega);
+
+// Residual b - A x of the owned cells (the sum of the neighbours minus count - 1 times the cell, zero on the spots)
+// and the largest change a Jacobi sweep would make, the residual divided by count. The ghost cells must be up to date.
+float stencilResidual(const Grid &current, const StencilData &stencil, Grid &residual);
+
+// Iterates the local block with the scheme of the options until the whole plate converges and returns the final max
+// diff. Checkpoints and snapshots are written as configured by the options, restartIteration is the iteration current
+// was restored from.
+float simulate(Grid &current, const StencilData &stencil, const Decomposition &decomposition, const Options &options,
+               long restartIteration = 0);
+
+#endif //HW2_SOLVER_H
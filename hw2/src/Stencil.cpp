@@ -0,0 +1,182 @@
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "Stencil.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HW2_X86_KERNELS
+#endif
+
+// Single cell of the stencil, the summation order is shared by all kernels.
+static inline float averageCell(const float *above, const float *row, const float *below, const uint8_t *fixed,
+                                const float *colWeight, float rowWeight, int x, float &diff) {
+    if (fixed[x])
+        return row[x];
+
+    float sum = row[x];
+    sum += row[x - 1];
+    sum += row[x + 1];
+    sum += above[x];
+    sum += above[x + 1];
+    sum += above[x - 1];
+    sum += below[x];
+    sum += below[x + 1];
+    sum += below[x - 1];
+
+    float newTemperature = sum / (colWeight[x] * rowWeight);
+    diff = std::max(std::abs(row[x] - newTemperature), diff);
+
+    return newTemperature;
+}
+
+static float stencilRowScalar(const float *above, const float *row, const float *below, float *out,
+                              const uint8_t *fixed, const float *colWeight, float rowWeight, int width) {
+    float diff = 0;
+    for (int x = 0; x < width; ++x)
+        out[x] = averageCell(above, row, below, fixed, colWeight, rowWeight, x, diff);
+    return diff;
+}
+
+#ifdef HW2_X86_KERNELS
+
+__attribute__((target("avx2")))
+static float stencilRowAvx2(const float *above, const float *row, const float *below, float *out,
+                            const uint8_t *fixed, const float *colWeight, float rowWeight, int width) {
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 vRowWeight = _mm256_set1_ps(rowWeight);
+    __m256 vDiff = _mm256_setzero_ps();
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256 center = _mm256_loadu_ps(row + x);
+        __m256 sum = center;
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(row + x - 1));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(row + x + 1));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(above + x));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(above + x + 1));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(above + x - 1));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(below + x));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(below + x + 1));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(below + x - 1));
+
+        __m256 count = _mm256_mul_ps(_mm256_loadu_ps(colWeight + x), vRowWeight);
+        __m256 value = _mm256_div_ps(sum, count);
+
+        // Fixed spots keep their temperature, so they contribute zero to the diff.
+        __m256i fixed32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (fixed + x)));
+        __m256 isFixed = _mm256_castsi256_ps(_mm256_cmpgt_epi32(fixed32, _mm256_setzero_si256()));
+        value = _mm256_blendv_ps(value, center, isFixed);
+
+        _mm256_storeu_ps(out + x, value);
+        vDiff = _mm256_max_ps(vDiff, _mm256_andnot_ps(signMask, _mm256_sub_ps(center, value)));
+    }
+
+    __m128 half = _mm_max_ps(_mm256_castps256_ps128(vDiff), _mm256_extractf128_ps(vDiff, 1));
+    half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+    float diff = _mm_cvtss_f32(half);
+
+    for (; x < width; ++x)
+        out[x] = averageCell(above, row, below, fixed, colWeight, rowWeight, x, diff);
+
+    return diff;
+}
+
+__attribute__((target("avx512f")))
+static float stencilRowAvx512(const float *above, const float *row, const float *below, float *out,
+                              const uint8_t *fixed, const float *colWeight, float rowWeight, int width) {
+    const __m512 vRowWeight = _mm512_set1_ps(rowWeight);
+    __m512 vDiff = _mm512_setzero_ps();
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m512 center = _mm512_loadu_ps(row + x);
+        __m512 sum = center;
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(row + x - 1));
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(row + x + 1));
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(above + x));
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(above + x + 1));
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(above + x - 1));
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(below + x));
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(below + x + 1));
+        sum = _mm512_add_ps(sum, _mm512_loadu_ps(below + x - 1));
+
+        __m512 count = _mm512_mul_ps(_mm512_loadu_ps(colWeight + x), vRowWeight);
+        __m512 value = _mm512_div_ps(sum, count);
+
+        __m512i fixed32 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *) (fixed + x)));
+        __mmask16 isFixed = _mm512_test_epi32_mask(fixed32, fixed32);
+        value = _mm512_mask_blend_ps(isFixed, value, center);
+
+        _mm512_storeu_ps(out + x, value);
+        vDiff = _mm512_max_ps(vDiff, _mm512_abs_ps(_mm512_sub_ps(center, value)));
+    }
+
+    float diff = _mm512_reduce_max_ps(vDiff);
+
+    for (; x < width; ++x)
+        out[x] = averageCell(above, row, below, fixed, colWeight, rowWeight, x, diff);
+
+    return diff;
+}
+
+#endif
+
+KernelIsa detectKernelIsa() {
+#ifdef HW2_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return KernelIsa::Avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return KernelIsa::Avx2;
+#endif
+    return KernelIsa::Scalar;
+}
+
+KernelIsa parseKernelIsa(const std::string &name) {
+    if (name == "auto")
+        return KernelIsa::Auto;
+    if (name == "scalar")
+        return KernelIsa::Scalar;
+    if (name == "avx2")
+        return KernelIsa::Avx2;
+    if (name == "avx512")
+        return KernelIsa::Avx512;
+
+    throw std::runtime_error("Unknown kernel '" + name + "'!\n");
+}
+
+const char *kernelIsaName(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::Auto:
+            return "auto";
+        case KernelIsa::Scalar:
+            return "scalar";
+        case KernelIsa::Avx2:
+            return "avx2";
+        case KernelIsa::Avx512:
+            return "avx512";
+    }
+    return "unknown";
+}
+
+StencilRowKernel selectStencilKernel(KernelIsa isa) {
+    KernelIsa supported = detectKernelIsa();
+    if (isa == KernelIsa::Auto)
+        isa = supported;
+
+    if (isa > supported)
+        throw std::runtime_error(std::string("Kernel ") + kernelIsaName(isa) + " is not supported by this CPU!\n");
+
+    switch (isa) {
+#ifdef HW2_X86_KERNELS
+        case KernelIsa::Avx512:
+            return stencilRowAvx512;
+        case KernelIsa::Avx2:
+            return stencilRowAvx2;
+#endif
+        default:
+            return stencilRowScalar;
+    }
+}
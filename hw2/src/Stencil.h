@@ -0,0 +1,33 @@
+#ifndef HW2_STENCIL_H
+#define HW2_STENCIL_H
+
+#include <cstdint>
+#include <string>
+
+// Instruction set used by the 9-point averaging kernel.
+enum class KernelIsa {
+    Auto,
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+// Averages one row of the 9-point stencil and writes it to out, returns max |old - new| of the row.
+// above, row and below point to column 0 and must be readable at columns -1 and width (ghost cells).
+// The number of averaged cells is rowWeight * colWeight[x], fixed[x] != 0 keeps the old temperature.
+//
+// Every kernel performs the same IEEE operations in the same order (no FMA contraction, true division),
+// so the vector kernels are bitwise identical to the scalar reference, i.e. the tolerance is 0.
+typedef float (*StencilRowKernel)(const float *above, const float *row, const float *below, float *out,
+                                  const uint8_t *fixed, const float *colWeight, float rowWeight, int width);
+
+KernelIsa detectKernelIsa();
+
+KernelIsa parseKernelIsa(const std::string &name);
+
+const char *kernelIsaName(KernelIsa isa);
+
+// Returns the kernel for isa, Auto picks the widest one the CPU supports.
+StencilRowKernel selectStencilKernel(KernelIsa isa);
+
+#endif //HW2_STENCIL_H
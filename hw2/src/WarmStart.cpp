@@ -0,0 +1,158 @@
+#include <mpi.h>
+#include <cmath>
+#include <algorithm>
+#include "WarmStart.h"
+#include "Solver.h"
+
+// The coarsest level has at most this many cells along its longer side.
+const int COARSEST_SIDE = 16;
+
+// Lower bound of the cells of the finest level, which otherwise matches a block.
+const long FINEST_MIN_CELLS = 4096;
+
+// Plate of the spots coarsened by factor, with the stencil data of a whole plate on one rank.
+struct WarmLevel {
+    int factor = 1;
+    Grid field;
+    StencilData stencil;
+};
+
+static int coarsened(int length, int factor) {
+    return (length + factor - 1) / factor;
+}
+
+static WarmLevel createLevel(int width, int height, int factor, KernelIsa isa) {
+    WarmLevel level;
+    level.factor = factor;
+    level.field = Grid(coarsened(width, factor), coarsened(height, factor), 1, 128);
+
+    StencilData &stencil = level.stencil;
+    stencil.x0 = 0;
+    stencil.y0 = 0;
+    stencil.halo = 1;
+    stencil.stride = level.field.stride;
+    stencil.isSpot = std::vector<uint8_t>(level.field.size(), 0);
+    stencil.colWeight = axisWeights(-1, level.field.width + 2, level.field.width);
+    stencil.rowWeight = axisWeights(-1, level.field.height + 2, level.field.height);
+    stencil.kernel = selectStencilKernel(isa);
+    return level;
+}
+
+// Imposes the mean temperature of the spots in every coarse cell that covers any.
+static void imposeSpots(WarmLevel &level, const std::vector<Spot> &spots) {
+    Grid &field = level.field;
+    std::vector<float> sum(field.size(), 0.0f);
+    std::vector<int> count(field.size(), 0);
+    for (auto &spot: spots) {
+        size_t i = (size_t) (spot.mY / level.factor + 1) * field.stride + spot.mX / level.factor + 1;
+        sum[i] += spot.mTemperature;
+        count[i]++;
+    }
+
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (count[i] > 0) {
+            field.cells[i] = sum[i] / (float) count[i];
+            level.stencil.isSpot[i] = 1;
+        }
+    }
+}
+
+// Jacobi sweeps over the whole level until the max diff falls below tolerance.
+static void relax(WarmLevel &level, const float &tolerance) {
+    const StencilData &stencil = level.stencil;
+    Grid &field = level.field;
+    Grid next = field;
+
+    float diff;
+    do {
+        diff = 0;
+#pragma omp parallel for schedule(static) reduction(max:diff)
+        for (int y = 0; y < field.height; ++y) {
+            diff = std::max(stencil.kernel(field.row(y - 1), field.row(y), field.row(y + 1), next.row(y),
+                                           stencil.spotRow(y), &stencil.colWeight[1], stencil.rowWeight[y + 1],
+                                           field.width), diff);
+        }
+        std::swap(field, next);
+    } while (diff >= tolerance);
+}
+
+// Bilinear weights of the fine indices [from, from + count) between the centres of the coarse cells, each covering
+// factor fine cells, clamped to the outer centres.
+static void axisInterpolation(int from, int count, int factor, int coarseLength, std::vector<int> &first,
+                              std::vector<float> &weight) {
+    first.resize(count);
+    weight.resize(count);
+    for (int i = 0; i < count; ++i) {
+        float position = ((float) (from + i) + 0.5f) / (float) factor - 0.5f;
+        position = std::min(std::max(position, 0.0f), (float) (coarseLength - 1));
+        first[i] = std::min((int) position, std::max(coarseLength - 2, 0));
+        weight[i] = coarseLength > 1 ? position - (float) first[i] : 0.0f;
+    }
+}
+
+// Fills the owned cells of fine, a block at [x0, y0] of the plate, from the coarse plate of factor times its cells.
+static void interpolate(const Grid &coarse, int factor, int x0, int y0, Grid &fine) {
+    std::vector<int> firstX, firstY;
+    std::vector<float> weightX, weightY;
+    axisInterpolation(x0, fine.width, factor, coarse.width, firstX, weightX);
+    axisInterpolation(y0, fine.height, factor, coarse.height, firstY, weightY);
+    int nextX = coarse.width > 1 ? 1 : 0;
+    int nextY = coarse.height > 1 ? 1 : 0;
+
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < fine.height; ++y) {
+        const float *top = coarse.row(firstY[y]);
+        const float *bottom = coarse.row(firstY[y] + nextY);
+        float *out = fine.row(y);
+        for (int x = 0; x < fine.width; ++x) {
+            int i = firstX[x];
+            float upper = top[i] + weightX[x] * (top[i + nextX] - top[i]);
+            float lower = bottom[i] + weightX[x] * (bottom[i + nextX] - bottom[i]);
+            out[x] = upper + weightY[y] * (lower - upper);
+        }
+    }
+}
+
+void warmStart(const std::vector<Spot> &spots, const Decomposition &decomposition, const Options &options,
+               Grid &current) {
+    int width = decomposition.width;
+    int height = decomposition.height;
+
+    // The finest level has the cells of one block, so rank 0 spends on it no more than a share of the solve.
+    long budget = std::max((long) width * height / decomposition.size, FINEST_MIN_CELLS);
+    int finest = 2;
+    while ((long) coarsened(width, finest) * coarsened(height, finest) > budget)
+        finest *= 2;
+
+    int shape[3] = {0, 0, finest};
+    Grid coarse;
+    if (decomposition.rank == 0) {
+        int factor = finest;
+        while (std::max(coarsened(width, factor), coarsened(height, factor)) > COARSEST_SIDE)
+            factor *= 2;
+
+        WarmLevel level;
+        for (; factor >= finest; factor /= 2) {
+            WarmLevel finer = createLevel(width, height, factor, options.kernel);
+            if (level.field.size() > 0)
+                interpolate(level.field, 2, 0, 0, finer.field);
+            imposeSpots(finer, spots);
+            relax(finer, CONVERGENCE_THRESHOLD * (float) factor * (float) factor);
+            level = std::move(finer);
+        }
+
+        // Without the ghost ring for the broadcast.
+        coarse = Grid(level.field.width, level.field.height, 0, 0.0f);
+        for (int y = 0; y < coarse.height; ++y)
+            std::copy(level.field.row(y), level.field.row(y) + coarse.width, coarse.row(y));
+        shape[0] = coarse.width;
+        shape[1] = coarse.height;
+    }
+
+    MPI_Bcast(shape, 3, MPI_INT, 0, decomposition.comm);
+    if (decomposition.rank != 0)
+        coarse = Grid(shape[0], shape[1], 0, 0.0f);
+    MPI_Bcast(coarse.cells, (int) coarse.size(), MPI_FLOAT, 0, decomposition.comm);
+
+    interpolate(coarse, shape[2], decomposition.local.x0, decomposition.local.y0, current);
+}
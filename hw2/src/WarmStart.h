@@ -0,0 +1,21 @@
+#ifndef HW2_WARM_START_H
+#define HW2_WARM_START_H
+
+#include <vector>
+#include "Grid.h"
+#include "Instance.h"
+#include "Decomposition.h"
+#include "Options.h"
+
+// Nested iteration initial guess. Rank 0 coarsens the spot map by powers of two down to a small plate, where a coarse
+// cell is a spot with the mean temperature of the spots it covers, solves it by Jacobi sweeps from the uniform 128
+// and interpolates the result bilinearly as the start of the next finer level. The finest of these levels has at most
+// the cells of one block, it is broadcast and every rank interpolates it into the owned cells of current. The ghost
+// cells are left alone, the spots of current are imposed afterwards as usual.
+//
+// A level of factor F stops at a max diff of F * F times the threshold, the diff of a sweep falls with the square of
+// the plate side for the same error. Collective over decomposition.comm, spots are only read on rank 0.
+void warmStart(const std::vector<Spot> &spots, const Decomposition &decomposition, const Options &options,
+               Grid &current);
+
+#endif //HW2_WARM_START_H
@@ -22,7 +22,7 @@ void SendSchedules(int destination, std::vector<Schedule> schedules) {
 }
 
 
-std::vector<Schedule> ReceiveSchedules(const TaskList &taskList) {
+std::vector<Schedule> ReceiveSchedules(SchedulePool &pool) {
     MPI_Status status;
     int number_amount;
 
@@ -36,14 +36,14 @@ std::vector<Schedule> ReceiveSchedules(const TaskList &taskList) {
     std::vector<int> S(0);
     std::vector<int> N(0);
 
-    std::vector<bool> used(taskList.size(), false);
+    std::vector<bool> used(pool.getTasks().size(), false);
     for (int n : message) {
         if (n == -1){
             for (int i = 0; i < used.size(); ++i)
                 if (!used[i])
                     N.push_back(i);
 
-            schedules.emplace_back(taskList,S,N);
+            schedules.emplace_back(pool,S,N);
             S.clear();
             N.clear();
 
@@ -99,7 +99,7 @@ void SendSchedule(int destination, Schedule schedule) {
 }
 
 
-Schedule ReceiveSchedule(const TaskList &taskList) {
+Schedule ReceiveSchedule(SchedulePool &pool) {
     MPI_Status status;
     int number_amount;
 
@@ -121,7 +121,7 @@ Schedule ReceiveSchedule(const TaskList &taskList) {
             N.push_back(part);
     }
 
-    return Schedule(taskList,S,N);
+    return Schedule(pool,S,N);
 }
 
 void PassToken(int destination, int token) {
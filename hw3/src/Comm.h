@@ -28,10 +28,10 @@ MPI_Datatype CreateMpiTaskType();
 //Communication
 void SendSchedule(int destination, Schedule schedule);
 
-Schedule ReceiveSchedule(const TaskList& taskList);
+Schedule ReceiveSchedule(SchedulePool &pool);
 
 void SendSchedules(int destination, std::vector<Schedule> schedules);
-std::vector<Schedule> ReceiveSchedules(const TaskList &taskList);
+std::vector<Schedule> ReceiveSchedules(SchedulePool &pool);
 
 void PassToken(int destination, int token);
 
@@ -10,97 +10,274 @@
 #include <sstream>
 
 
+//Nodes carved from one chunk of the pool
+const int NODES_PER_CHUNK = 4096;
+
+void SchedulePool::reset(const TaskList &_tasks) {
+    tasks = &_tasks;
+    words = std::max((int) (_tasks.size() + 63) / 64, 1);
+    nodeSize = sizeof(ScheduleNode) / sizeof(uint64_t) + 3 * words;
+    chunks.clear();
+    freeNodes = nullptr;
+
+    int n = (int) _tasks.size();
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+
+    releaseRank.resize(n);
+    byRelease.resize(n);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return _tasks[a].releaseTime < _tasks[b].releaseTime;
+    });
+    for (int rank = 0; rank < n; ++rank) {
+        releaseRank[order[rank]] = rank;
+        byRelease[rank] = &_tasks[order[rank]];
+    }
+
+    latestStartRank.resize(n);
+    byLatestStart.resize(n);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return _tasks[a].deadline - _tasks[a].processTime < _tasks[b].deadline - _tasks[b].processTime;
+    });
+    for (int rank = 0; rank < n; ++rank) {
+        latestStartRank[order[rank]] = rank;
+        byLatestStart[rank] = &_tasks[order[rank]];
+    }
+
+    unschedulable.resize(n);
+    for (int i = 0; i < n; ++i)
+        unschedulable[i] = _tasks[i].releaseTime + _tasks[i].processTime > _tasks[i].deadline;
+}
+
+ScheduleNode *SchedulePool::allocate() {
+    if (!freeNodes) {
+        chunks.emplace_back(nodeSize * NODES_PER_CHUNK);
+        for (int i = NODES_PER_CHUNK - 1; i >= 0; --i) {
+            auto node = reinterpret_cast<ScheduleNode *>(&chunks.back()[i * nodeSize]);
+            node->parent = freeNodes;
+            freeNodes = node;
+        }
+    }
+
+    ScheduleNode *node = freeNodes;
+    freeNodes = node->parent;
+    return node;
+}
+
+void SchedulePool::release(ScheduleNode *node) {
+    while (node && --node->references == 0) {
+        ScheduleNode *parent = node->parent;
+        node->parent = freeNodes;
+        freeNodes = node;
+        node = parent;
+    }
+}
+
+//Index of the lowest set bit, -1 without any
+static int firstBit(const uint64_t *bits, int words) {
+    for (int w = 0; w < words; ++w)
+        if (bits[w])
+            return w * 64 + __builtin_ctzll(bits[w]);
+    return -1;
+}
+
+void SchedulePool::clear(ScheduleNode *node) const {
+    std::fill(node->notScheduled(), node->notScheduled() + 3 * words, 0);
+    node->notScheduledCount = 0;
+    node->remainingTime = 0;
+    node->minRelease = INT32_MAX;
+    node->minLatestStart = INT32_MAX;
+    node->unschedulableCount = 0;
+}
+
+void SchedulePool::addNotScheduled(ScheduleNode *node, int i) const {
+    uint64_t *bits = node->notScheduled();
+    int release = releaseRank[i];
+    int latestStart = latestStartRank[i];
+    bits[i / 64] |= 1ull << (i % 64);
+    bits[words + release / 64] |= 1ull << (release % 64);
+    bits[2 * words + latestStart / 64] |= 1ull << (latestStart % 64);
+
+    const Task &task = (*tasks)[i];
+    node->notScheduledCount++;
+    node->remainingTime += task.processTime;
+    node->minRelease = std::min(node->minRelease, task.releaseTime);
+    node->minLatestStart = std::min(node->minLatestStart, task.deadline - task.processTime);
+    node->unschedulableCount += unschedulable[i];
+}
+
+void SchedulePool::removeNotScheduled(ScheduleNode *node, int i) const {
+    uint64_t *bits = node->notScheduled();
+    int release = releaseRank[i];
+    int latestStart = latestStartRank[i];
+    bits[i / 64] &= ~(1ull << (i % 64));
+    bits[words + release / 64] &= ~(1ull << (release % 64));
+    bits[2 * words + latestStart / 64] &= ~(1ull << (latestStart % 64));
+
+    const Task &task = (*tasks)[i];
+    node->notScheduledCount--;
+    node->remainingTime -= task.processTime;
+    node->unschedulableCount -= unschedulable[i];
+
+    if (task.releaseTime == node->minRelease) {
+        int first = firstBit(bits + words, words);
+        node->minRelease = first < 0 ? INT32_MAX : byRelease[first]->releaseTime;
+    }
+    if (task.deadline - task.processTime == node->minLatestStart) {
+        int first = firstBit(bits + 2 * words, words);
+        node->minLatestStart = first < 0 ? INT32_MAX : byLatestStart[first]->deadline - byLatestStart[first]->processTime;
+    }
+}
+
+void SchedulePool::copyNotScheduled(const ScheduleNode *from, ScheduleNode *to) const {
+    std::copy(from->notScheduled(), from->notScheduled() + 3 * words, to->notScheduled());
+    to->notScheduledCount = from->notScheduledCount;
+    to->remainingTime = from->remainingTime;
+    to->minRelease = from->minRelease;
+    to->minLatestStart = from->minLatestStart;
+    to->unschedulableCount = from->unschedulableCount;
+}
+
 void Schedule::print(const int &myRank) const {
     std::stringstream ss;
 
     ss << "CPU" << myRank;
 
     ss << " schedule - Scheduled: ";
-    for (auto i: scheduled)
+    for (auto i: getScheduled())
         ss << "T" << i->n << "(" << i->processTime << "," << i->releaseTime << "," << i->deadline << ") ";
     ss << "Not scheduled: ";
-    for (auto i: notScheduled)
+    for (auto i: getNotScheduled())
         ss << "T" << i->n << "(" << i->processTime << "," << i->releaseTime << "," << i->deadline << ") ";
 
-    ss << "with length " << length;
+    ss << "with length " << getLength();
 
     ss << std::endl;
 
     std::cout << ss.str();
 }
 
-Schedule::Schedule(const TaskList &_taskList, int initialTask) {
-    scheduled = std::vector<const Task *>(0);
-    notScheduled = std::vector<const Task *>(0);
+//New node extending _parent by _task, holding a reference of _parent. The unscheduled set is left to the caller.
+ScheduleNode *Schedule::createNode(const ScheduleNode *_parent, const Task *_task) {
+    ScheduleNode *created = pool->allocate();
+    created->parent = const_cast<ScheduleNode *>(_parent);
+    created->task = _task;
+    created->length = _parent ? _parent->length : 0;
+    if (_task)
+        created->length = std::max(_task->releaseTime, created->length) + _task->processTime;
+    created->references = 1;
 
-    for (int i = 0; i < _taskList.size(); ++i) {
-        if (_taskList[i].n == initialTask)
-            scheduled.push_back(&_taskList[i]);
-        else
-            notScheduled.push_back(&_taskList[i]);
-    }
+    if (_parent)
+        created->parent->references++;
 
-    length = calculateLength();
+    return created;
 }
 
-Schedule::Schedule(const TaskList &_taskList, const std::vector<int> &_scheduled,
-                   const std::vector<int> &_notScheduled) {
-    scheduled = std::vector<const Task *>(0);
-    notScheduled = std::vector<const Task *>(0);
+Schedule::Schedule(SchedulePool &_pool, int initialTask) {
+    pool = &_pool;
+    const TaskList &taskList = pool->getTasks();
 
-    for (auto n: _scheduled)
-        scheduled.push_back(&_taskList[n]);
+    int initial = -1;
+    for (int i = 0; i < (int) taskList.size(); ++i)
+        if (taskList[i].n == initialTask)
+            initial = i;
 
-    for (auto n: _notScheduled)
-        notScheduled.push_back(&_taskList[n]);
+    node = createNode(nullptr, initial >= 0 ? &taskList[initial] : nullptr);
+    pool->clear(node);
+    for (int i = 0; i < (int) taskList.size(); ++i)
+        if (i != initial)
+            pool->addNotScheduled(node, i);
+}
 
-    length = calculateLength();
+Schedule::Schedule(SchedulePool &_pool, const std::vector<int> &_scheduled,
+                   const std::vector<int> &_notScheduled) {
+    pool = &_pool;
+    const TaskList &taskList = pool->getTasks();
+
+    //The prefixes only carry the order, their unscheduled sets are never read
+    node = createNode(nullptr, nullptr);
+    for (auto n: _scheduled) {
+        ScheduleNode *prefix = node;
+        node = createNode(prefix, &taskList[n]);
+        pool->release(prefix);
+    }
+
+    pool->clear(node);
+    for (auto n: _notScheduled)
+        pool->addNotScheduled(node, n);
 }
 
 Schedule::Schedule(const Schedule &_schedule, const Task *_task) {
-    scheduled = std::vector<const Task *>(_schedule.scheduled.size() + 1);
-    notScheduled = std::vector<const Task *>(_schedule.notScheduled.size() - 1);
+    pool = _schedule.pool;
+    node = createNode(_schedule.node, _task);
 
-    std::copy(_schedule.scheduled.begin(), _schedule.scheduled.end(), scheduled.begin());
-    scheduled.back() = _task;
+    pool->copyNotScheduled(_schedule.node, node);
+    pool->removeNotScheduled(node, (int) (_task - pool->getTasks().data()));
+}
 
-    int i = 0;
-    for (const auto &task: _schedule.notScheduled)
-        if (task != _task) {
-            notScheduled[i] = task;
-            i++;
-        }
+Schedule::Schedule(const Schedule &_schedule) : node(_schedule.node), pool(_schedule.pool) {
+    if (node)
+        node->references++;
+}
+
+Schedule::Schedule(Schedule &&_schedule) noexcept: node(_schedule.node), pool(_schedule.pool) {
+    _schedule.node = nullptr;
+}
+
+Schedule &Schedule::operator=(const Schedule &_schedule) {
+    if (_schedule.node)
+        _schedule.node->references++;
+    if (node)
+        pool->release(node);
+
+    node = _schedule.node;
+    pool = _schedule.pool;
+    return *this;
+}
+
+Schedule &Schedule::operator=(Schedule &&_schedule) noexcept {
+    if (this != &_schedule) {
+        if (node)
+            pool->release(node);
+
+        node = _schedule.node;
+        pool = _schedule.pool;
+        _schedule.node = nullptr;
+    }
+    return *this;
+}
 
-    length = std::max(_task->releaseTime, _schedule.length) + _task->processTime;
-    //length = calculateLength();
+Schedule::~Schedule() {
+    if (node)
+        pool->release(node);
 }
 
 std::vector<const Task *> Schedule::getScheduled() const {
+    std::vector<const Task *> scheduled;
+    for (const ScheduleNode *prefix = node; prefix; prefix = prefix->parent)
+        if (prefix->task)
+            scheduled.push_back(prefix->task);
+
+    std::reverse(scheduled.begin(), scheduled.end());
     return scheduled;
 }
 
 std::vector<const Task *> Schedule::getNotScheduled() const {
+    std::vector<const Task *> notScheduled;
+    notScheduled.reserve(node->notScheduledCount);
+    forEachNotScheduled([&](const Task *task) { notScheduled.push_back(task); });
     return notScheduled;
 }
 
-bool Schedule::isValid(const int &UB) const {
-
-    //Missed deadline
-    for (auto task: notScheduled) {
-        if (std::max(length, task->releaseTime) + task->processTime > task->deadline)
-            return false;
-    }
+bool ScheduleNode::isValid(const int &UB) const {
+    //Missed deadline: an unscheduled task misses it when it cannot start before its latest start, either after the
+    //schedule or at its release
+    if (length > minLatestStart || unschedulableCount > 0)
+        return false;
 
     //Violated upper bound
-    if (!notScheduled.empty()) {
-        int min = INT32_MAX;
-        int sum = 0;
-        for (auto task: notScheduled) {
-            min = std::min(min, task->releaseTime);
-            sum += task->processTime;
-        }
-        int max = std::max(length, min);
-        int LB = max + sum;
+    if (notScheduledCount > 0) {
+        int LB = std::max(length, minRelease) + remainingTime;
         if (LB >= UB)
             return false;
     }
@@ -108,28 +285,22 @@ bool Schedule::isValid(const int &UB) const {
     return true;
 }
 
-int Schedule::calculateLength() {
-    int len = 0;
-
-    for (auto task: scheduled) {
-        len = std::max(task->releaseTime, len) + task->processTime;
-    }
-
-    return len;
+bool Schedule::isValid(const int &UB) const {
+    return node->isValid(UB);
 }
 
 int Schedule::getLength() const {
-    return length;
+    return node ? node->length : 0;
 }
 
 bool Schedule::isSolution() const {
-    return notScheduled.empty();
+    return node->isSolution();
 }
 
 std::vector<int> Schedule::getScheduledIndex() const {
     std::vector<int> vec;
 
-    for (auto task: scheduled) {
+    for (auto task: getScheduled()) {
         vec.push_back(task->n);
     }
 
@@ -139,21 +310,74 @@ std::vector<int> Schedule::getScheduledIndex() const {
 std::vector<int> Schedule::getNotScheduledIndex() const {
     std::vector<int> vec;
 
-    for (auto task: notScheduled)
-        vec.push_back(task->n);
+    forEachNotScheduled([&](const Task *task) { vec.push_back(task->n); });
 
     return vec;
 }
 
 bool Schedule::isOptimal() const{
-    int min = INT32_MAX;
-    for(auto task : notScheduled)
-        if (min > task->releaseTime)
-            min = task->releaseTime;
+    return node->isOptimal();
+}
 
-    return length <= min;
+ScheduleState::~ScheduleState() {
+    if (node)
+        pool->release(node);
 }
 
+void ScheduleState::load(const Schedule &schedule) {
+    if (!node) {
+        pool = schedule.pool;
+        node = pool->allocate();
+        node->parent = nullptr;
+        node->task = nullptr;
+        node->references = 1;
+    }
 
+    pool->copyNotScheduled(schedule.node, node);
+    node->length = schedule.node->length;
 
+    order.clear();
+    lengths.clear();
+    for (const ScheduleNode *prefix = schedule.node; prefix; prefix = prefix->parent)
+        if (prefix->task)
+            order.push_back((int) (prefix->task - pool->getTasks().data()));
+    std::reverse(order.begin(), order.end());
+}
+
+void ScheduleState::apply(int i) {
+    lengths.push_back(node->length);
+    order.push_back(i);
+    node->length = lengthWith(i);
+    pool->removeNotScheduled(node, i);
+}
 
+void ScheduleState::undo() {
+    pool->addNotScheduled(node, order.back());
+    node->length = lengths.back();
+    order.pop_back();
+    lengths.pop_back();
+}
+
+Schedule ScheduleState::materialize(int depth, int i) const {
+    std::vector<int> scheduled(order.begin(), order.begin() + depth);
+    scheduled.push_back(i);
+
+    std::vector<bool> used(pool->getTasks().size(), false);
+    for (auto n: scheduled)
+        used[n] = true;
+
+    std::vector<int> notScheduled;
+    int count = (int) used.size();
+    for (int n = 0; n < count; ++n)
+        if (!used[n])
+            notScheduled.push_back(n);
+
+    return Schedule(*pool, scheduled, notScheduled);
+}
+
+Schedule ScheduleState::materialize() const {
+    std::vector<int> notScheduled;
+    forEachNotScheduled([&](int i) { notScheduled.push_back(i); });
+
+    return Schedule(*pool, order, notScheduled);
+}
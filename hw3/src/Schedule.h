@@ -7,33 +7,125 @@
 
 
 #include <vector>
+#include <cstdint>
+#include <algorithm>
 #include "InstanceLoader.h"
 
-class Schedule {
+//Node of the search tree. The order of the scheduled tasks is the chain of parents, the unscheduled tasks are three
+//bitsets stored right behind the node: by task index, by rank of the release time and by rank of the latest start
+//(deadline minus process time). Nodes are shared by the schedules extending them and reference counted.
+struct ScheduleNode {
+    ScheduleNode *parent;
+    const Task *task;
+    int length;
+    int notScheduledCount;
+    int references;
+
+    //Aggregates of the unscheduled tasks, kept up to date with the bitsets
+    int remainingTime;
+    int minRelease;
+    int minLatestStart;
+    int unschedulableCount;
+
+    uint64_t *notScheduled() { return reinterpret_cast<uint64_t *>(this + 1); }
+
+    const uint64_t *notScheduled() const { return reinterpret_cast<const uint64_t *>(this + 1); }
+
+    bool isSolution() const { return notScheduledCount == 0; }
+    bool isValid(const int &UB) const;
+    bool isOptimal() const { return length <= minRelease; }
+};
+
+//Per worker allocator of the nodes. Nodes are carved from large chunks and recycled through a free list, so expanding
+//a node allocates nothing once the pool has grown to the size of the search.
+class SchedulePool {
 private:
+    const TaskList *tasks = nullptr;
+    int words = 0;
+    size_t nodeSize = 0;
 
+    //Ranks of the tasks by release time and by latest start, the tasks of the ranks, and the tasks that miss their
+    //deadline even when started at their release time
+    std::vector<int> releaseRank;
+    std::vector<int> latestStartRank;
+    std::vector<const Task *> byRelease;
+    std::vector<const Task *> byLatestStart;
+    std::vector<bool> unschedulable;
 
-    std::vector<const Task *> scheduled;
-    std::vector<const Task *> notScheduled;
-    int length;
+    std::vector<std::vector<uint64_t>> chunks;
+    ScheduleNode *freeNodes = nullptr;
+
+public:
+    //Sizes the nodes for the task list and ranks its tasks, must be called before the first node is allocated
+    void reset(const TaskList &_tasks);
+
+    ScheduleNode *allocate();
+
+    //Drops one reference of the node, the node and then its parents return to the pool once unreferenced
+    void release(ScheduleNode *node);
+
+    //Empties the unscheduled set of the node
+    void clear(ScheduleNode *node) const;
+
+    //Adds or removes the task with index i in the unscheduled set of the node and updates the aggregates. Removing
+    //rescans the bitset words only when the task held the minimum release or latest start.
+    void addNotScheduled(ScheduleNode *node, int i) const;
+    void removeNotScheduled(ScheduleNode *node, int i) const;
+
+    //Copies the unscheduled set and the aggregates
+    void copyNotScheduled(const ScheduleNode *from, ScheduleNode *to) const;
+
+    //Calls f with the index of every unscheduled task of the node in the order of the task list
+    template<typename F>
+    void forEachNotScheduled(const ScheduleNode *node, F f) const {
+        const uint64_t *bits = node->notScheduled();
+        for (int w = 0; w < words; ++w)
+            for (uint64_t word = bits[w]; word; word &= word - 1)
+                f(w * 64 + __builtin_ctzll(word));
+    }
+
+    const TaskList &getTasks() const { return *tasks; }
+
+    int getWords() const { return words; }
+};
 
-    int calculateLength();
+class Schedule {
+private:
+    friend class ScheduleState;
+
+    ScheduleNode *node = nullptr;
+    SchedulePool *pool = nullptr;
+
+    ScheduleNode *createNode(const ScheduleNode *_parent, const Task *_task);
 
 
 public:
-    Schedule(): length(0){};
-    Schedule(const TaskList &_taskList, int initialTask);
+    Schedule() = default;
+    Schedule(SchedulePool &_pool, int initialTask);
 
-    Schedule(const TaskList &_taskList, const std::vector<int> &_scheduled, const std::vector<int> &_notScheduled);
+    Schedule(SchedulePool &_pool, const std::vector<int> &_scheduled, const std::vector<int> &_notScheduled);
 
     Schedule(const Schedule &_schedule, const Task *_task);
 
+    Schedule(const Schedule &_schedule);
+    Schedule(Schedule &&_schedule) noexcept;
+    Schedule &operator=(const Schedule &_schedule);
+    Schedule &operator=(Schedule &&_schedule) noexcept;
+    ~Schedule();
+
     bool isSolution() const;
     bool isValid(const int &UB) const;
     bool isOptimal() const;
 
     void print(const int &myRank) const;
 
+    //Calls f with every unscheduled task in the order of the task list
+    template<typename F>
+    void forEachNotScheduled(F f) const {
+        const Task *tasks = pool->getTasks().data();
+        pool->forEachNotScheduled(node, [&](int i) { f(&tasks[i]); });
+    }
+
     std::vector<const Task *> getScheduled() const;
     std::vector<const Task *> getNotScheduled() const;
 
@@ -45,5 +137,56 @@ public:
 
 };
 
+//Mutable schedule of the depth-first search. Tasks are applied on top of a loaded schedule and undone in reverse order,
+//the unscheduled set and its aggregates live in a single node of the pool, so neither allocates once the vectors have
+//grown to the depth of the search.
+class ScheduleState {
+private:
+    SchedulePool *pool = nullptr;
+    ScheduleNode *node = nullptr;
+
+    //Indices of the scheduled tasks and the length before each of them
+    std::vector<int> order;
+    std::vector<int> lengths;
+
+public:
+    ScheduleState() = default;
+    ScheduleState(const ScheduleState &) = delete;
+    ScheduleState &operator=(const ScheduleState &) = delete;
+    ~ScheduleState();
+
+    //Replaces the state with the schedule
+    void load(const Schedule &schedule);
+
+    void apply(int i);
+    void undo();
+
+    //Length after applying the task with index i
+    int lengthWith(int i) const {
+        const Task &task = pool->getTasks()[i];
+        return std::max(task.releaseTime, node->length) + task.processTime;
+    }
+
+    bool isSolution() const { return node->isSolution(); }
+    bool isValid(const int &UB) const { return node->isValid(UB); }
+    bool isOptimal() const { return node->isOptimal(); }
+
+    //Calls f with the index of every unscheduled task in the order of the task list
+    template<typename F>
+    void forEachNotScheduled(F f) const {
+        pool->forEachNotScheduled(node, f);
+    }
+
+    int getLength() const { return node->length; }
+
+    int getDepth() const { return (int) order.size(); }
+
+    //Schedule of the first depth tasks of the state followed by the task with index i
+    Schedule materialize(int depth, int i) const;
+
+    //Schedule of the whole state
+    Schedule materialize() const;
+};
+
 
 #endif //HW3_SCHEDULE_H
@@ -5,7 +5,10 @@
 #include <mpi.h>
 #include "Worker.h"
 #include "Comm.h"
-#include "queue"
+#include <algorithm>
+
+//Search nodes processed between two checks for messages
+const int NODES_PER_PROBE = 256;
 
 Worker::Worker(const int &myRankInput, const int &worldSizeInput, const std::string &outputPath) {
     this->worldSize = worldSizeInput;
@@ -34,6 +37,7 @@ void Worker::InitialTasksDistribution(const std::string &path) {
 
     //Broadcast all tasks
     MPI_Bcast(&tasks[0], tasks.size(), MPITaskType, 0, MPI_COMM_WORLD);
+    pool.reset(tasks);
 
     int m = 0;
     for (auto task: tasks)
@@ -55,14 +59,14 @@ void Worker::InitialJobDistribution() {
 
 void Worker::WorkingLoop() {
     while (cpuAlive) {
-        if (backlog.empty() && !assignedRootTasks.empty()) {
+        if (backlog.empty() && frames.empty() && !assignedRootTasks.empty()) {
             int task = assignedRootTasks.top();
             assignedRootTasks.pop();
 
-            backlog.emplace_back(tasks, task);
+            backlog.emplace_back(pool, task);
         }
 
-        if (backlog.empty())
+        if (backlog.empty() && frames.empty())
             Idling();
         else
             Work();
@@ -88,6 +92,8 @@ void Worker::Work() {
     if (probeFlag) {
         backlog.clear();
         assignedRootTasks = std::stack<int>();
+        frames.clear();
+        candidates.clear();
         return;
     }
 
@@ -95,16 +101,21 @@ void Worker::Work() {
     MPI_Iprobe(MPI_ANY_SOURCE, MYTAG_JOB_REQUEST, MPI_COMM_WORLD, &probeFlag, &status);
 
     //Working
-    Schedule top = backlog.front();
-    backlog.pop_front();
+    if (frames.empty()) {
+        state.load(backlog.front());
+        backlog.pop_front();
+        ProcessNode();
+    }
 
-    ProcessSchedule(top);
+    for (int i = 0; i < NODES_PER_PROBE && !frames.empty(); ++i)
+        Step();
 
 
     if (probeFlag) {
         MPI_Recv(nullptr, 0, MPI_INT, status.MPI_SOURCE, MYTAG_JOB_REQUEST, MPI_COMM_WORLD, &status);
 
-        if (backlog.empty()) {
+        std::optional<Schedule> donation = TakeDonation();
+        if (!donation) {
             bool res = false;
             MPI_Send(&res, 1, MPI_CXX_BOOL, status.MPI_SOURCE, MYTAG_JOB_REQUEST_RESPONSE, MPI_COMM_WORLD);
 
@@ -119,23 +130,63 @@ void Worker::Work() {
 
         std::vector<Schedule> toSend(0);
 
-        toSend.push_back(backlog.back());
-        backlog.pop_back();
+        toSend.push_back(donation.value());
 
         SendSchedules(status.MPI_SOURCE, toSend);
     }
 }
 
-void Worker::ProcessSchedule(const Schedule &schedule) {
-/*    std::cout << "Proccessing... ";
-    schedule.print(myRank);*/
+//Work for another worker: the last schedule of the backlog, otherwise the untried child of the shallowest frame that
+//the search would try last
+std::optional<Schedule> Worker::TakeDonation() {
+    if (!backlog.empty()) {
+        Schedule schedule = backlog.back();
+        backlog.pop_back();
+        return schedule;
+    }
+
+    for (auto &frame: frames) {
+        for (int i = frame.end - 1; i >= frame.next; --i) {
+            if (candidates[i] >= 0) {
+                Schedule schedule = state.materialize(frame.depth, candidates[i]);
+                candidates[i] = -1;
+                return schedule;
+            }
+        }
+    }
 
-    if (schedule.isValid(UB)) {
-        if (schedule.isSolution()) {
+    return std::nullopt;
+}
+
+//Applies the next untried child of the deepest frame and processes it, or undoes the node of an exhausted frame
+void Worker::Step() {
+    Frame &frame = frames.back();
+    while (frame.next < frame.end && candidates[frame.next] < 0)
+        frame.next++;
+
+    if (frame.next == frame.end) {
+        frames.pop_back();
+        candidates.resize(frames.empty() ? 0 : frames.back().end);
+        if (!frames.empty())
+            state.undo();
+        return;
+    }
+
+    state.apply(candidates[frame.next++]);
+    ProcessNode();
+}
+
+//Processes the node of state: a solution may improve the UB, an optimal prefix drops all other work and a valid node
+//gets a frame of its children, the shortest first. A node without a frame is undone unless it was loaded.
+void Worker::ProcessNode() {
+    bool expanded = false;
+
+    if (state.isValid(UB)) {
+        if (state.isSolution()) {
             //I have a solution
-            if (schedule.getLength() < UB) {
-                UB = schedule.getLength();
-                bestSchedule = schedule;
+            if (state.getLength() < UB) {
+                UB = state.getLength();
+                bestSchedule = state.materialize();
 
                 for (int i = 0; i < worldSize; ++i) {
                     MPI_Request request;
@@ -145,8 +196,10 @@ void Worker::ProcessSchedule(const Schedule &schedule) {
             }
 
         } else {
-            if (schedule.isOptimal()) {
+            if (state.isOptimal()) {
                 backlog = std::deque<Schedule>();
+                for (auto &frame: frames)
+                    frame.next = frame.end;
 
                 for (int i = 0; i < worldSize; ++i) {
                     MPI_Request request;
@@ -155,26 +208,21 @@ void Worker::ProcessSchedule(const Schedule &schedule) {
                 }
             }
 
-            struct CustomCompare
-            {
-                bool operator()(const Schedule& lhs, const Schedule& rhs)
-                {
-                    return lhs.getLength() < rhs.getLength();
-                }
-            };
-
-            std::priority_queue<Schedule,std::vector<Schedule>, CustomCompare > pq;
-            for (auto task: schedule.getNotScheduled()) {
-                pq.push(Schedule(schedule, task));
-            }
-
-            while (!pq.empty()){
-                backlog.push_front(pq.top());
-                pq.pop();
-            }
+            int begin = (int) candidates.size();
+            state.forEachNotScheduled([&](int i) { candidates.push_back(i); });
+            std::sort(candidates.begin() + begin, candidates.end(), [&](int a, int b) {
+                int lengthA = state.lengthWith(a);
+                int lengthB = state.lengthWith(b);
+                return lengthA < lengthB || (lengthA == lengthB && a < b);
+            });
 
+            frames.push_back({state.getDepth(), begin, (int) candidates.size()});
+            expanded = true;
         }
     }
+
+    if (!expanded && !frames.empty())
+        state.undo();
 }
 
 void Worker::Idling() {
@@ -260,7 +308,7 @@ void Worker::HandleIdleEnd() {
                     N.push_back(part);
             }
 
-            results.emplace_back(tasks, S, N);
+            results.emplace_back(pool, S, N);
         }
 
 
@@ -321,7 +369,7 @@ void Worker::HandleIdleTokenReceive() {
 }
 
 void Worker::HandleIdleScheduleReceive() {
-    auto schedule = ReceiveSchedules(tasks);
+    auto schedule = ReceiveSchedules(pool);
 
     for (const auto &x: schedule)
         backlog.push_back(x);
@@ -346,7 +394,7 @@ void Worker::HandleIdleJobResponse(int source) {
     //TODO: Still don't know why this muset be commented out
     /*if (res) {
         std::cout << myRank << " is sadly waiting dor his promised schedule" << std::endl;
-        auto gift = ReceiveSchedule(tasks);
+        auto gift = ReceiveSchedule(pool);
         backlog.push(gift);
         std::cout << myRank << " is happy cause he received his promised schedule" << std::endl;
     }*/
@@ -15,7 +15,22 @@
 
 class Worker {
 private:
+    //Declared first, the schedules below hold nodes of the pool
+    SchedulePool pool;
+
     std::deque<Schedule> backlog;
+
+    //Depth-first search over the tasks applied to state on top of a schedule of the backlog. A frame holds the untried
+    //children of the node with depth scheduled tasks, as task indices [next, end) of candidates, -1 once donated.
+    struct Frame {
+        int depth;
+        int next;
+        int end;
+    };
+    ScheduleState state;
+    std::vector<int> candidates;
+    std::vector<Frame> frames;
+
     std::stack<int> assignedRootTasks;
     int myRank;
     int worldSize;
@@ -47,7 +62,11 @@ public:
 
     void InitialTasksDistribution(const std::string& path);
 
-    void ProcessSchedule(const Schedule &schedule);
+    void ProcessNode();
+
+    void Step();
+
+    std::optional<Schedule> TakeDonation();
 
     void Idling();
 